@@ -2,15 +2,24 @@
 #include "bitboards.h"
 #include "enums.h"
 #include "structs.h"
+#include <assert.h>
+#include <inttypes.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 
+#ifdef TABLEGEN
 uint64_t pawn_attacks[2][64];
 uint64_t knight_attacks[64];
 uint64_t king_attacks[64];
-uint64_t bishop_attacks[64][512];
-uint64_t rook_attacks[64][4096];
+uint64_t slider_attacks[SLIDER_TABLE_SIZE];
+uint32_t bishop_offsets[64];
+uint32_t rook_offsets[64];
 uint64_t bishop_masks[64];
 uint64_t rook_masks[64];
+uint64_t between_masks[64][64];
+uint64_t line_masks[64][64];
+#endif
 uint64_t file_masks[64];
 uint64_t rank_masks[64];
 uint64_t isolated_masks[64];
@@ -33,7 +42,7 @@ const int rook_relevant_bits[64] = {
     11, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 10, 10, 11,
     11, 10, 10, 10, 10, 10, 10, 11, 12, 11, 11, 11, 11, 11, 11, 12};
 
-uint64_t rook_magic_numbers[64] = {
+const uint64_t rook_magic_numbers[64] = {
     0x8a80104000800020ULL, 0x140002000100040ULL,  0x2801880a0017001ULL,
     0x100081001000420ULL,  0x200020010080420ULL,  0x3001c0002010008ULL,
     0x8480008002000100ULL, 0x2080088004402900ULL, 0x800098204000ULL,
@@ -58,7 +67,7 @@ uint64_t rook_magic_numbers[64] = {
     0x1004081002402ULL};
 
 // bishop magic numbers
-uint64_t bishop_magic_numbers[64] = {
+const uint64_t bishop_magic_numbers[64] = {
     0x40040844404084ULL,   0x2004208a004208ULL,   0x10190041080202ULL,
     0x108060845042010ULL,  0x581104180800210ULL,  0x2112080446200010ULL,
     0x1080820820060210ULL, 0x3c0808410220200ULL,  0x4050404440404ULL,
@@ -315,22 +324,6 @@ uint64_t rook_attacks_on_the_fly(int square, uint64_t block) {
   return attacks;
 }
 
-// init leaper pieces attacks
-void init_leapers_attacks(void) {
-  // loop over 64 board squares
-  for (int square = 0; square < 64; square++) {
-    // init pawn attacks
-    pawn_attacks[white][square] = mask_pawn_attacks(white, square);
-    pawn_attacks[black][square] = mask_pawn_attacks(black, square);
-
-    // init knight attacks
-    knight_attacks[square] = mask_knight_attacks(square);
-
-    // init king attacks
-    king_attacks[square] = mask_king_attacks(square);
-  }
-}
-
 // set occupancies
 uint64_t set_occupancy(int index, int bits_in_mask, uint64_t attack_mask) {
   // occupancy map
@@ -354,8 +347,28 @@ uint64_t set_occupancy(int index, int bits_in_mask, uint64_t attack_mask) {
   return occupancy;
 }
 
+#ifdef TABLEGEN
+// init leaper pieces attacks
+void init_leapers_attacks(void) {
+  // loop over 64 board squares
+  for (int square = 0; square < 64; square++) {
+    // init pawn attacks
+    pawn_attacks[white][square] = mask_pawn_attacks(white, square);
+    pawn_attacks[black][square] = mask_pawn_attacks(black, square);
+
+    // init knight attacks
+    knight_attacks[square] = mask_knight_attacks(square);
+
+    // init king attacks
+    king_attacks[square] = mask_king_attacks(square);
+  }
+}
+
 // init slider piece's attack tables
 void init_sliders_attacks(void) {
+  // running offset into the packed slider table
+  uint32_t offset = 0;
+
   // loop over 64 board squares
   for (int square = 0; square < 64; square++) {
     // init bishop & rook masks
@@ -363,13 +376,19 @@ void init_sliders_attacks(void) {
     rook_masks[square] = mask_rook_attacks(square);
 
     // init relevant occupancy bit count
-    int bishop_relevant_bits_count = __builtin_popcountll(bishop_masks[square]);
-    int rook_relevant_bits_count = __builtin_popcountll(rook_masks[square]);
+    int bishop_relevant_bits_count = bishop_relevant_bits[square];
+    int rook_relevant_bits_count = rook_relevant_bits[square];
 
     // init occupancy indicies
     int bishop_occupancy_indicies = (1 << bishop_relevant_bits_count);
     int rook_occupancy_indicies = (1 << rook_relevant_bits_count);
 
+    // every square only needs as many entries as it has variations
+    bishop_offsets[square] = offset;
+    offset += bishop_occupancy_indicies;
+    rook_offsets[square] = offset;
+    offset += rook_occupancy_indicies;
+
     // loop over occupancy indicies
     for (int index = 0; index < bishop_occupancy_indicies; index++) {
       // bishop
@@ -377,12 +396,17 @@ void init_sliders_attacks(void) {
       uint64_t occupancy =
           set_occupancy(index, bishop_relevant_bits_count, bishop_masks[square]);
 
+#ifdef USE_PEXT
+      // PEXT of an occupancy variation is its index
+      int attack_index = index;
+#else
       // init magic index
-      int magic_index = (occupancy * bishop_magic_numbers[square]) >>
-                        (64 - bishop_relevant_bits[square]);
+      int attack_index = (occupancy * bishop_magic_numbers[square]) >>
+                         (64 - bishop_relevant_bits[square]);
+#endif
 
       // init bishop attacks
-      bishop_attacks[square][magic_index] =
+      slider_attacks[bishop_offsets[square] + attack_index] =
           bishop_attacks_on_the_fly(square, occupancy);
     }
 
@@ -393,18 +417,161 @@ void init_sliders_attacks(void) {
       uint64_t occupancy =
           set_occupancy(index, rook_relevant_bits_count, rook_masks[square]);
 
+#ifdef USE_PEXT
+      // PEXT of an occupancy variation is its index
+      int attack_index = index;
+#else
       // init magic index
-      int magic_index = (occupancy * rook_magic_numbers[square]) >>
-                        (64 - rook_relevant_bits[square]);
+      int attack_index = (occupancy * rook_magic_numbers[square]) >>
+                         (64 - rook_relevant_bits[square]);
+#endif
 
       // init rook attacks
-      rook_attacks[square][magic_index] =
+      slider_attacks[rook_offsets[square] + attack_index] =
           rook_attacks_on_the_fly(square, occupancy);
     }
   }
+
+  assert(offset == SLIDER_TABLE_SIZE);
+
+  // init squares between and the full line through two aligned squares
+  for (int from = 0; from < 64; from++) {
+    for (int to = 0; to < 64; to++) {
+      uint64_t from_bb = 1ULL << from;
+      uint64_t to_bb = 1ULL << to;
+
+      if (bishop_attacks_on_the_fly(from, 0ULL) & to_bb) {
+        between_masks[from][to] = bishop_attacks_on_the_fly(from, to_bb) &
+                                  bishop_attacks_on_the_fly(to, from_bb);
+        line_masks[from][to] = (bishop_attacks_on_the_fly(from, 0ULL) &
+                                bishop_attacks_on_the_fly(to, 0ULL)) |
+                               from_bb | to_bb;
+      } else if (rook_attacks_on_the_fly(from, 0ULL) & to_bb) {
+        between_masks[from][to] = rook_attacks_on_the_fly(from, to_bb) &
+                                  rook_attacks_on_the_fly(to, from_bb);
+        line_masks[from][to] = (rook_attacks_on_the_fly(from, 0ULL) &
+                                rook_attacks_on_the_fly(to, 0ULL)) |
+                               from_bb | to_bb;
+      }
+    }
+  }
+}
+#else
+#ifndef USE_PEXT
+// software PEXT, gathers the bits of value selected by mask into the low bits
+static uint64_t pext_software(uint64_t value, uint64_t mask) {
+  uint64_t result = 0ULL;
+  for (uint64_t bit = 1ULL; mask; bit <<= 1, mask &= mask - 1)
+    if (value & mask & -mask)
+      result |= bit;
+  return result;
+}
+#endif
+
+// index of an occupancy in the slider table of a square, by PEXT or magics
+static inline uint64_t pext_index(uint64_t occupancy, uint64_t mask) {
+#ifdef USE_PEXT
+  return _pext_u64(occupancy, mask);
+#else
+  return pext_software(occupancy, mask);
+#endif
+}
+
+static inline uint64_t magic_index(uint64_t occupancy, uint64_t mask,
+                                   uint64_t magic, int bits) {
+  return ((occupancy & mask) * magic) >> (64 - bits);
+}
+
+// compare the lookups of one slider against the ray walk, printing failures
+// while report is set
+static uint64_t verify_slider(uint64_t *pext_table, uint64_t *magic_table,
+                              int square, uint64_t occupancy, int is_rook,
+                              int report) {
+  uint32_t offset = is_rook ? rook_offsets[square] : bishop_offsets[square];
+  uint64_t mask = is_rook ? rook_masks[square] : bishop_masks[square];
+  uint64_t expected = is_rook ? rook_attacks_on_the_fly(square, occupancy)
+                              : bishop_attacks_on_the_fly(square, occupancy);
+  uint64_t magic = is_rook ? rook_magic_numbers[square]
+                           : bishop_magic_numbers[square];
+  int bits = is_rook ? rook_relevant_bits[square]
+                     : bishop_relevant_bits[square];
+  uint64_t pext = pext_table[offset + pext_index(occupancy, mask)];
+  uint64_t magic_attacks =
+      magic_table[offset + magic_index(occupancy, mask, magic, bits)];
+  uint64_t engine = is_rook ? get_rook_attacks(square, occupancy)
+                            : get_bishop_attacks(square, occupancy);
+
+  if (pext == expected && magic_attacks == expected && engine == expected)
+    return 0;
+
+  if (report)
+    printf("%s on %d occupancy 0x%016" PRIx64
+           ": pext %s, magic %s, engine %s\n",
+           is_rook ? "rook" : "bishop", square, occupancy,
+           pext == expected ? "ok" : "wrong",
+           magic_attacks == expected ? "ok" : "wrong",
+           engine == expected ? "ok" : "wrong");
+  return 1;
+}
+
+// Builds a PEXT indexed and a magic indexed slider table and checks that both
+// lookups, and the one compiled into the engine, agree with the ray walk for
+// every relevant occupancy and for random full board occupancies. Returns the
+// number of failed lookups
+uint64_t verify_sliders_attacks(uint64_t *lookups) {
+  uint64_t *pext_table = malloc(SLIDER_TABLE_SIZE * sizeof(uint64_t));
+  uint64_t *magic_table = malloc(SLIDER_TABLE_SIZE * sizeof(uint64_t));
+  uint64_t failed = 0, seed = 0x9E3779B97F4A7C15ULL;
+  *lookups = 0;
+
+  for (int square = 0; square < 64; square++) {
+    for (int is_rook = 0; is_rook <= 1; is_rook++) {
+      uint32_t offset = is_rook ? rook_offsets[square] : bishop_offsets[square];
+      uint64_t mask = is_rook ? rook_masks[square] : bishop_masks[square];
+      uint64_t magic = is_rook ? rook_magic_numbers[square]
+                               : bishop_magic_numbers[square];
+      int bits = is_rook ? rook_relevant_bits[square]
+                         : bishop_relevant_bits[square];
+      for (int index = 0; index < (1 << bits); index++) {
+        uint64_t occupancy = set_occupancy(index, bits, mask);
+        uint64_t attacks = is_rook
+                               ? rook_attacks_on_the_fly(square, occupancy)
+                               : bishop_attacks_on_the_fly(square, occupancy);
+        pext_table[offset + index] = attacks;
+        magic_table[offset + magic_index(occupancy, mask, magic, bits)] =
+            attacks;
+      }
+    }
+  }
+
+  for (int square = 0; square < 64; square++) {
+    for (int is_rook = 0; is_rook <= 1; is_rook++) {
+      uint64_t mask = is_rook ? rook_masks[square] : bishop_masks[square];
+      int bits = is_rook ? rook_relevant_bits[square]
+                         : bishop_relevant_bits[square];
+
+      // every relevant occupancy, then random boards with pieces outside of
+      // the mask
+      for (int index = 0; index < (1 << bits); index++) {
+        failed += verify_slider(pext_table, magic_table, square,
+                                set_occupancy(index, bits, mask), is_rook,
+                                failed < 8);
+        ++*lookups;
+      }
+      for (int sample = 0; sample < 4096; sample++) {
+        seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+        failed += verify_slider(pext_table, magic_table, square,
+                                seed & (seed >> 8), is_rook, failed < 8);
+        ++*lookups;
+      }
+    }
+  }
+
+  free(pext_table);
+  free(magic_table);
+  return failed;
 }
 
-// is square current given attacked by the current given side
 int is_square_attacked(position_t *pos, int square, int side) {
   // attacked by white pawns
   if ((side == white) &&
@@ -447,3 +614,4 @@ int is_square_attacked(position_t *pos, int square, int side) {
   // by default return false
   return 0;
 }
+#endif
@@ -1,31 +1,70 @@
 #ifndef ATTACKS_H
 #define ATTACKS_H
 
+#include "enums.h"
 #include "structs.h"
 #include <stdint.h>
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
 
+extern const uint64_t not_a_file;
+extern const uint64_t not_h_file;
 extern const int bishop_relevant_bits[64];
 extern const int rook_relevant_bits[64];
-extern uint64_t rook_magic_numbers[64];
-extern uint64_t bishop_magic_numbers[64];
-
-extern uint64_t pawn_attacks[2][64];
-extern uint64_t knight_attacks[64];
-extern uint64_t king_attacks[64];
-extern uint64_t bishop_attacks[64][512];
-extern uint64_t rook_attacks[64][4096];
-extern uint64_t bishop_masks[64];
-extern uint64_t rook_masks[64];
+extern const uint64_t rook_magic_numbers[64];
+extern const uint64_t bishop_magic_numbers[64];
+
+// The attack tables are filled by the init functions only inside the table
+// generator (Tools/tablegen.c), the engine links its output as constants
+#ifdef TABLEGEN
+#define TABLE
+#else
+#define TABLE const
+#endif
+
+extern TABLE uint64_t pawn_attacks[2][64];
+extern TABLE uint64_t knight_attacks[64];
+extern TABLE uint64_t king_attacks[64];
+// bishop and rook attacks of all squares packed back to back, every square
+// only holding as many entries as it has occupancy variations
+#define SLIDER_TABLE_SIZE (5248 + 102400)
+extern TABLE uint64_t slider_attacks[SLIDER_TABLE_SIZE];
+extern TABLE uint32_t bishop_offsets[64];
+extern TABLE uint32_t rook_offsets[64];
+extern TABLE uint64_t bishop_masks[64];
+extern TABLE uint64_t rook_masks[64];
+extern TABLE uint64_t between_masks[64][64];
+extern TABLE uint64_t line_masks[64][64];
 extern uint64_t file_masks[64];
 extern uint64_t rank_masks[64];
 extern uint64_t isolated_masks[64];
 extern uint64_t white_passed_masks[64];
 extern uint64_t black_passed_masks[64];
 
-int is_square_attacked(position_t *pos, int square, int side);
+#ifdef TABLEGEN
+uint64_t bishop_attacks_on_the_fly(int square, uint64_t block);
+uint64_t rook_attacks_on_the_fly(int square, uint64_t block);
 void init_sliders_attacks(void);
 void init_leapers_attacks(void);
+#else
+int is_square_attacked(position_t *pos, int square, int side);
+uint64_t verify_sliders_attacks(uint64_t *lookups);
+#endif
 
+#ifdef USE_PEXT
+// get bishop attacks
+static inline uint64_t get_bishop_attacks(int square, uint64_t occupancy) {
+  return slider_attacks[bishop_offsets[square] +
+                        _pext_u64(occupancy, bishop_masks[square])];
+}
+
+// get rook attacks
+static inline uint64_t get_rook_attacks(int square, uint64_t occupancy) {
+  return slider_attacks[rook_offsets[square] +
+                        _pext_u64(occupancy, rook_masks[square])];
+}
+#else
 // get bishop attacks
 static inline uint64_t get_bishop_attacks(int square, uint64_t occupancy) {
   // get bishop attacks assuming current board occupancy
@@ -34,7 +73,7 @@ static inline uint64_t get_bishop_attacks(int square, uint64_t occupancy) {
   occupancy >>= 64 - bishop_relevant_bits[square];
 
   // return bishop attacks
-  return bishop_attacks[square][occupancy];
+  return slider_attacks[bishop_offsets[square] + occupancy];
 }
 
 // get rook attacks
@@ -45,38 +84,14 @@ static inline uint64_t get_rook_attacks(int square, uint64_t occupancy) {
   occupancy >>= 64 - rook_relevant_bits[square];
 
   // return rook attacks
-  return rook_attacks[square][occupancy];
+  return slider_attacks[rook_offsets[square] + occupancy];
 }
+#endif
 
 // get queen attacks
 static inline uint64_t get_queen_attacks(int square, uint64_t occupancy) {
-  // init result attacks bitboard
-  uint64_t queen_attacks = 0ULL;
-
-  // init bishop occupancies
-  uint64_t bishop_occupancy = occupancy;
-
-  // init rook occupancies
-  uint64_t rook_occupancy = occupancy;
-
-  // get bishop attacks assuming current board occupancy
-  bishop_occupancy &= bishop_masks[square];
-  bishop_occupancy *= bishop_magic_numbers[square];
-  bishop_occupancy >>= 64 - bishop_relevant_bits[square];
-
-  // get bishop attacks
-  queen_attacks = bishop_attacks[square][bishop_occupancy];
-
-  // get rook attacks assuming current board occupancy
-  rook_occupancy &= rook_masks[square];
-  rook_occupancy *= rook_magic_numbers[square];
-  rook_occupancy >>= 64 - rook_relevant_bits[square];
-
-  // get rook attacks
-  queen_attacks |= rook_attacks[square][rook_occupancy];
-
-  // return queen attacks
-  return queen_attacks;
+  return get_bishop_attacks(square, occupancy) |
+         get_rook_attacks(square, occupancy);
 }
 
 static inline uint64_t get_pawn_attacks(uint8_t side, int square) {
@@ -89,4 +104,22 @@ static inline uint64_t get_knight_attacks(int square) {
 
 static inline uint64_t get_king_attacks(int square) { return king_attacks[square]; }
 
+static inline uint64_t all_attackers_to_square(position_t *pos, uint64_t occupied, int sq) {
+
+  // Finds the pieces of both sides attacking a square given an occupied
+  // bitboard, which will likely not match the actual board, as pieces are
+  // removed during static exchange evaluation or when testing king moves
+
+  return (get_pawn_attacks(white, sq) & pos->bitboards[p]) |
+         (get_pawn_attacks(black, sq) & pos->bitboards[P]) |
+         (get_knight_attacks(sq) & (pos->bitboards[n] | pos->bitboards[N])) |
+         (get_bishop_attacks(sq, occupied) &
+          ((pos->bitboards[b] | pos->bitboards[B]) |
+           (pos->bitboards[q] | pos->bitboards[Q]))) |
+         (get_rook_attacks(sq, occupied) &
+          ((pos->bitboards[r] | pos->bitboards[R]) |
+           (pos->bitboards[q] | pos->bitboards[Q]))) |
+         (get_king_attacks(sq) & (pos->bitboards[k] | pos->bitboards[K]));
+}
+
 #endif
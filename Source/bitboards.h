@@ -23,29 +23,6 @@ static inline int poplsb(uint64_t *bb) {
   return lsb;
 }
 
-// preserve board state
-#define copy_board(bitboards, occupancies, side, enpassant, castle, fifty,     \
-                   hash_key, mailbox)                                          \
-  uint64_t bitboards_copy[12], occupancies_copy[3];                            \
-  uint8_t mailbox_copy[64];                                                    \
-  int side_copy, enpassant_copy, castle_copy, fifty_copy;                      \
-  memcpy(bitboards_copy, bitboards, 96);                                       \
-  memcpy(occupancies_copy, occupancies, 24);                                   \
-  memcpy(mailbox_copy, mailbox, 64);                                           \
-  side_copy = side, enpassant_copy = enpassant, castle_copy = castle;          \
-  fifty_copy = fifty;                                                          \
-  uint64_t hash_key_copy = hash_key;
-
-// restore board state
-#define restore_board(bitboards, occupancies, side, enpassant, castle, fifty,  \
-                      hash_key, mailbox)                                       \
-  memcpy(bitboards, bitboards_copy, 96);                                       \
-  memcpy(occupancies, occupancies_copy, 24);                                   \
-  memcpy(mailbox, mailbox_copy, 64);                                           \
-  side = side_copy, enpassant = enpassant_copy, castle = castle_copy;          \
-  fifty = fifty_copy;                                                          \
-  hash_key = hash_key_copy;
-
 #define set_bit(bitboard, square) ((bitboard) |= (1ULL << (square)))
 #define get_bit(bitboard, square) ((bitboard) & (1ULL << (square)))
 #define pop_bit(bitboard, square) ((bitboard) &= ~(1ULL << (square)))
@@ -86,6 +86,18 @@ enum { opening, endgame, middlegame };
 // piece types
 enum { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
 
-enum { NON_PV, PV_NODE };
+// search node types
+enum { NON_PV, PV_NODE, ROOT_NODE };
+
+// move picker stages
+enum {
+  STAGE_TT,
+  STAGE_GENERATE,
+  STAGE_GOOD_NOISY,
+  STAGE_KILLER,
+  STAGE_QUIETS,
+  STAGE_BAD_NOISY,
+  STAGE_DONE
+};
 
 #endif
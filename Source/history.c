@@ -1,6 +1,9 @@
+#include "history.h"
 #include "move.h"
 #include "utils.h"
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 int CAPTURE_HISTORY_BONUS_MAX = 1323;
 int QUIET_HISTORY_BONUS_MAX = 1410;
@@ -35,26 +38,20 @@ static inline void update_quiet_history(thread_t *thread,
 static inline void update_capture_history(thread_t *thread,
                                           int move, uint8_t depth,
                                           uint8_t is_best_move) {
-  int from = get_move_source(move);
-  int target = get_move_target(move);
+  int16_t *entry = capture_history_entry(thread, &thread->pos, move);
   int bonus = 16 * depth * depth + 32 * depth + 16;
   int clamped_bonus =
       clamp(bonus, -CAPTURE_HISTORY_BONUS_MIN, CAPTURE_HISTORY_BONUS_MAX);
   int clamped_malus =
       clamp(bonus, -CAPTURE_HISTORY_MALUS_MIN, CAPTURE_HISTORY_MALUS_MAX);
   int adjust = is_best_move ? clamped_bonus : -clamped_malus;
-  thread->capture_history[thread->pos.mailbox[from]][thread->pos.mailbox[target]][from][target] +=
-      adjust - thread->capture_history[thread->pos.mailbox[from]][thread->pos.mailbox[target]][from]
-                                      [target] *
-                   abs(adjust) / HISTORY_MAX;
+  *entry += adjust - *entry * abs(adjust) / HISTORY_MAX;
 }
 
 static inline void update_continuation_history(thread_t *thread,
                                                searchstack_t *ss, int move,
                                                uint8_t depth,
                                                uint8_t is_best_move) {
-  int prev_piece = ss->piece;
-  int prev_target = get_move_target(ss->move);
   int piece = thread->pos.mailbox[get_move_source(move)];
   int target = get_move_target(move);
   int bonus = 16 * depth * depth + 32 * depth + 16;
@@ -63,10 +60,9 @@ static inline void update_continuation_history(thread_t *thread,
   int clamped_malus =
       clamp(bonus, -CONT_HISTORY_MALUS_MIN, CONT_HISTORY_MALUS_MAX);
   int adjust = is_best_move ? clamped_bonus : -clamped_malus;
-  thread->continuation_history[prev_piece][prev_target][piece][target] +=
+  ss->continuation_history[piece][target] +=
       adjust -
-      thread->continuation_history[prev_piece][prev_target][piece][target] *
-          abs(adjust) / HISTORY_MAX;
+      ss->continuation_history[piece][target] * abs(adjust) / HISTORY_MAX;
 }
 
 void update_quiet_history_moves(thread_t *thread,
@@ -114,8 +110,30 @@ void update_continuation_history_moves(thread_t *thread, searchstack_t *ss,
   }
 }
 
+// the table of the move at ss was cached when that move was made
 int16_t get_conthist_score(thread_t *thread, searchstack_t *ss, int move) {
-  return thread->continuation_history[ss->piece][get_move_target(
-      ss->move)][thread->pos.mailbox[get_move_source(move)]]
-                                     [get_move_target(move)];
+  return ss->continuation_history[thread->pos.mailbox[get_move_source(move)]]
+                                 [get_move_target(move)];
+}
+
+static void *clear_thread_histories(void *thread_info) {
+  thread_t *thread = (thread_t *)thread_info;
+  memset(thread->quiet_history, 0, sizeof(thread->quiet_history));
+  memset(thread->capture_history, 0, sizeof(thread->capture_history));
+  memset(thread->continuation_history, 0,
+         sizeof(thread->continuation_history));
+  return NULL;
+}
+
+// every thread clears its own tables in parallel, one thread after another
+// does not scale with high thread counts
+void clear_histories(thread_t *threads, int thread_count) {
+  pthread_t pthreads[thread_count];
+  for (int i = 0; i < thread_count; ++i) {
+    pthread_create(&pthreads[i], NULL, &clear_thread_histories, &threads[i]);
+  }
+
+  for (int i = 0; i < thread_count; ++i) {
+    pthread_join(pthreads[i], NULL);
+  }
 }
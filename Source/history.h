@@ -1,8 +1,19 @@
 #ifndef HISTORY_H
 #define HISTORY_H
 
+#include "move.h"
 #include "structs.h"
 
+// Captures are keyed by the captured piece type, en passant and quiet
+// promotions share the pawn entry
+static inline int16_t *capture_history_entry(thread_t *thread,
+                                             position_t *pos, uint16_t move) {
+  int source = get_move_source(move);
+  int target = get_move_target(move);
+  return &thread->capture_history[pos->mailbox[source]]
+                                 [pos->mailbox[target] % 6][source][target];
+}
+
 void update_quiet_history_moves(thread_t *thread,
                                 moves *quiet_moves, int best_move,
                                 uint8_t depth);
@@ -13,5 +24,6 @@ void update_continuation_history_moves(thread_t *thread, searchstack_t *ss,
                                        moves *quiet_moves, int best_move,
                                        uint8_t depth);
 int16_t get_conthist_score(thread_t *thread, searchstack_t *ss, int move);
+void clear_histories(thread_t *threads, int thread_count);
 
 #endif
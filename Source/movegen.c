@@ -4,10 +4,10 @@
 #include "enums.h"
 #include "move.h"
 #include "structs.h"
-#include <string.h>
+#include "utils.h"
 
 extern nnue_settings_t nnue_settings;
-extern keys_t keys;
+extern const keys_t keys;
 
 const int castling_rights[64] = {
     7,  15, 15, 15, 3,  15, 15, 11, 15, 15, 15, 15, 15, 15, 15, 15,
@@ -15,14 +15,95 @@ const int castling_rights[64] = {
     15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
     15, 15, 15, 15, 15, 15, 15, 15, 13, 15, 15, 15, 12, 15, 15, 14};
 
-int make_move(position_t *pos, int move, int move_flag) {
+#ifndef NDEBUG
+// compare incrementally updated occupancies and mailbox with the bitboards
+static uint8_t position_is_consistent(position_t *pos) {
+  uint64_t occupancies[3] = {0ULL, 0ULL, 0ULL};
+
+  for (int bb_piece = P; bb_piece <= k; bb_piece++) {
+    occupancies[bb_piece <= K ? white : black] |= pos->bitboards[bb_piece];
+
+    uint64_t bitboard = pos->bitboards[bb_piece];
+    while (bitboard)
+      if (pos->mailbox[poplsb(&bitboard)] != bb_piece)
+        return 0;
+  }
+  occupancies[both] = occupancies[white] | occupancies[black];
+
+  for (int square = 0; square < 64; square++)
+    if (pos->mailbox[square] == NO_PIECE &&
+        get_bit(occupancies[both], square))
+      return 0;
+
+  return occupancies[white] == pos->occupancies[white] &&
+         occupancies[black] == pos->occupancies[black] &&
+         occupancies[both] == pos->occupancies[both] &&
+         __builtin_popcountll(occupancies[both]) ==
+             __builtin_popcountll(pos->occupancies[white]) +
+                 __builtin_popcountll(pos->occupancies[black]);
+}
+#endif
+
+// find the pieces of a side pinned to its king and the enemy sliders pinning
+// them
+static inline void update_pins(position_t *pos, uint8_t side) {
+  uint8_t enemy = side ^ 1;
+  int king_square = get_lsb(pos->bitboards[side == white ? K : k]);
+  uint64_t enemies = pos->occupancies[enemy];
+
+  // enemy sliders that would attack the king through exactly one own piece
+  uint64_t snipers =
+      (get_rook_attacks(king_square, enemies) &
+       (pos->bitboards[enemy == white ? R : r] |
+        pos->bitboards[enemy == white ? Q : q])) |
+      (get_bishop_attacks(king_square, enemies) &
+       (pos->bitboards[enemy == white ? B : b] |
+        pos->bitboards[enemy == white ? Q : q]));
+
+  pos->check_info.pinned[side] = 0ULL;
+  pos->check_info.pinners[enemy] = 0ULL;
+  while (snipers) {
+    int sniper = poplsb(&snipers);
+    uint64_t blockers =
+        between_masks[king_square][sniper] & pos->occupancies[both];
+    if (blockers && !(blockers & (blockers - 1)) &&
+        (blockers & pos->occupancies[side])) {
+      pos->check_info.pinned[side] |= blockers;
+      pos->check_info.pinners[enemy] |= 1ULL << sniper;
+    }
+  }
+}
+
+// recompute checkers and pins, done once per position so search, SEE and
+// move generation can share them
+void update_check_info(position_t *pos) {
+  int king_square = get_lsb(pos->bitboards[pos->side == white ? K : k]);
+
+  pos->check_info.checkers =
+      all_attackers_to_square(pos, pos->occupancies[both], king_square) &
+      pos->occupancies[pos->side ^ 1];
+
+  update_pins(pos, white);
+  update_pins(pos, black);
+}
+
+// Makes a legal move and stores what is needed to take it back in undo.
+// Returns 0 without touching the position for non captures in capture mode
+int make_move(position_t *pos, int move, int move_flag, undo_t *undo) {
   int capture = get_move_capture(move);
   if (move_flag == only_captures && !capture) {
     return 0;
   }
-  // preserve board state
-  copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-             pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+
+  // preserve irreversible state
+  undo->hash_key = pos->hash_key;
+  undo->check_info = pos->check_info;
+  undo->fifty = pos->fifty;
+  undo->reversible_plies = pos->reversible_plies;
+  undo->plies_from_null = pos->plies_from_null;
+  undo->enpassant = pos->enpassant;
+  undo->castle = pos->castle;
+  undo->captured_piece = NO_PIECE;
 
   // parse move
   int source_square = get_move_source(move);
@@ -54,6 +135,8 @@ int make_move(position_t *pos, int move, int move_flag) {
 
       // remove it from corresponding bitboard
       pop_bit(pos->bitboards[bb_piece], target_square);
+      pop_bit(pos->occupancies[pos->side ^ 1], target_square);
+      undo->captured_piece = bb_piece;
 
       // remove the piece from hash key
       pos->hash_key ^= keys.piece_keys[bb_piece][target_square];
@@ -66,7 +149,10 @@ int make_move(position_t *pos, int move, int move_flag) {
     if (pos->side == white) {
       // remove captured pawn
       pop_bit(pos->bitboards[p], target_square + 8);
+      pop_bit(pos->occupancies[black], target_square + 8);
+      pop_bit(pos->occupancies[both], target_square + 8);
       pos->mailbox[target_square + 8] = NO_PIECE;
+      undo->captured_piece = p;
 
       // remove pawn from hash key
       pos->hash_key ^= keys.piece_keys[p][target_square + 8];
@@ -76,7 +162,10 @@ int make_move(position_t *pos, int move, int move_flag) {
     else {
       // remove captured pawn
       pop_bit(pos->bitboards[P], target_square - 8);
+      pop_bit(pos->occupancies[white], target_square - 8);
+      pop_bit(pos->occupancies[both], target_square - 8);
       pos->mailbox[target_square - 8] = NO_PIECE;
+      undo->captured_piece = P;
 
       // remove pawn from hash key
       pos->hash_key ^= keys.piece_keys[P][target_square - 8];
@@ -86,6 +175,10 @@ int make_move(position_t *pos, int move, int move_flag) {
   // move piece
   pop_bit(pos->bitboards[piece], source_square);
   set_bit(pos->bitboards[piece], target_square);
+  pop_bit(pos->occupancies[pos->side], source_square);
+  set_bit(pos->occupancies[pos->side], target_square);
+  pop_bit(pos->occupancies[both], source_square);
+  set_bit(pos->occupancies[both], target_square);
   pos->mailbox[source_square] = NO_PIECE;
   pos->mailbox[target_square] = piece;
 
@@ -162,6 +255,8 @@ int make_move(position_t *pos, int move, int move_flag) {
       // move H rook
       pop_bit(pos->bitboards[R], h1);
       set_bit(pos->bitboards[R], f1);
+      pos->occupancies[white] ^= (1ULL << h1) | (1ULL << f1);
+      pos->occupancies[both] ^= (1ULL << h1) | (1ULL << f1);
       pos->mailbox[h1] = NO_PIECE;
       pos->mailbox[f1] = R;
 
@@ -176,6 +271,8 @@ int make_move(position_t *pos, int move, int move_flag) {
       // move A rook
       pop_bit(pos->bitboards[R], a1);
       set_bit(pos->bitboards[R], d1);
+      pos->occupancies[white] ^= (1ULL << a1) | (1ULL << d1);
+      pos->occupancies[both] ^= (1ULL << a1) | (1ULL << d1);
       pos->mailbox[a1] = NO_PIECE;
       pos->mailbox[d1] = R;
 
@@ -190,6 +287,8 @@ int make_move(position_t *pos, int move, int move_flag) {
       // move H rook
       pop_bit(pos->bitboards[r], h8);
       set_bit(pos->bitboards[r], f8);
+      pos->occupancies[black] ^= (1ULL << h8) | (1ULL << f8);
+      pos->occupancies[both] ^= (1ULL << h8) | (1ULL << f8);
       pos->mailbox[h8] = NO_PIECE;
       pos->mailbox[f8] = r;
 
@@ -204,6 +303,8 @@ int make_move(position_t *pos, int move, int move_flag) {
       // move A rook
       pop_bit(pos->bitboards[r], a8);
       set_bit(pos->bitboards[r], d8);
+      pos->occupancies[black] ^= (1ULL << a8) | (1ULL << d8);
+      pos->occupancies[both] ^= (1ULL << a8) | (1ULL << d8);
       pos->mailbox[a8] = NO_PIECE;
       pos->mailbox[d8] = r;
 
@@ -225,47 +326,137 @@ int make_move(position_t *pos, int move, int move_flag) {
   // hash castling
   pos->hash_key ^= keys.castle_keys[pos->castle];
 
-  // reset occupancies
-  memset(pos->occupancies, 0ULL, 24);
+  // change side
+  pos->side ^= 1;
+
+  // hash side
+  pos->hash_key ^= keys.side_key;
+
+  // positions before an irreversible move can never repeat
+  pos->reversible_plies = pos->fifty ? pos->reversible_plies + 1 : 0;
+  pos->plies_from_null++;
 
-  // loop over white pieces bitboards
-  for (int bb_piece = P; bb_piece <= K; bb_piece++)
-    // update white occupancies
-    pos->occupancies[white] |= pos->bitboards[bb_piece];
+  update_check_info(pos);
 
-  // loop over black pieces bitboards
-  for (int bb_piece = p; bb_piece <= k; bb_piece++)
-    // update black occupancies
-    pos->occupancies[black] |= pos->bitboards[bb_piece];
+  assert(position_is_consistent(pos));
 
-  // update both sides occupancies
-  pos->occupancies[both] |= pos->occupancies[white];
-  pos->occupancies[both] |= pos->occupancies[black];
+  return 1;
+}
 
-  // change side
+// take back a move made with make_move
+void unmake_move(position_t *pos, int move, undo_t *undo) {
+  // change side back to the side that made the move
   pos->side ^= 1;
 
-  // hash side
-  pos->hash_key ^= keys.side_key;
+  // parse move
+  int source_square = get_move_source(move);
+  int target_square = get_move_target(move);
+  int piece = pos->mailbox[target_square];
 
-  // make sure that king has not been exposed into a check
-  if (is_square_attacked(pos,
-                         (pos->side == white)
-                             ? __builtin_ctzll(pos->bitboards[k])
-                             : __builtin_ctzll(pos->bitboards[K]),
-                         pos->side)) {
-    // take move back
-    restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                  pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
-
-    // return illegal move
-    return 0;
+  // turn promoted piece back into a pawn
+  if (is_move_promotion(move)) {
+    pop_bit(pos->bitboards[piece], target_square);
+    piece = pos->side == white ? P : p;
+    set_bit(pos->bitboards[piece], target_square);
   }
 
-  // otherwise
-  else
-    // return legal move
-    return 1;
+  // move piece back
+  pop_bit(pos->bitboards[piece], target_square);
+  set_bit(pos->bitboards[piece], source_square);
+  pop_bit(pos->occupancies[pos->side], target_square);
+  set_bit(pos->occupancies[pos->side], source_square);
+  pop_bit(pos->occupancies[both], target_square);
+  set_bit(pos->occupancies[both], source_square);
+  pos->mailbox[target_square] = NO_PIECE;
+  pos->mailbox[source_square] = piece;
+
+  // put captured piece back
+  if (undo->captured_piece != NO_PIECE) {
+    int capture_square = target_square;
+    if (get_move_enpassant(move))
+      capture_square += pos->side == white ? 8 : -8;
+    set_bit(pos->bitboards[undo->captured_piece], capture_square);
+    set_bit(pos->occupancies[pos->side ^ 1], capture_square);
+    set_bit(pos->occupancies[both], capture_square);
+    pos->mailbox[capture_square] = undo->captured_piece;
+  }
+
+  // move rook back
+  if (get_move_castling(move)) {
+    int rook = pos->side == white ? R : r;
+    int rook_source, rook_target;
+    switch (target_square) {
+    case (g1):
+      rook_source = h1, rook_target = f1;
+      break;
+    case (c1):
+      rook_source = a1, rook_target = d1;
+      break;
+    case (g8):
+      rook_source = h8, rook_target = f8;
+      break;
+    default:
+      rook_source = a8, rook_target = d8;
+      break;
+    }
+    pop_bit(pos->bitboards[rook], rook_target);
+    set_bit(pos->bitboards[rook], rook_source);
+    pos->occupancies[pos->side] ^= (1ULL << rook_source) | (1ULL << rook_target);
+    pos->occupancies[both] ^= (1ULL << rook_source) | (1ULL << rook_target);
+    pos->mailbox[rook_target] = NO_PIECE;
+    pos->mailbox[rook_source] = rook;
+  }
+
+  // restore irreversible state
+  pos->hash_key = undo->hash_key;
+  pos->check_info = undo->check_info;
+  pos->fifty = undo->fifty;
+  pos->reversible_plies = undo->reversible_plies;
+  pos->plies_from_null = undo->plies_from_null;
+  pos->enpassant = undo->enpassant;
+  pos->castle = undo->castle;
+
+  assert(position_is_consistent(pos));
+}
+
+// pass the move to the opponent
+void make_null_move(position_t *pos, undo_t *undo) {
+  undo->hash_key = pos->hash_key;
+  undo->check_info = pos->check_info;
+  undo->reversible_plies = pos->reversible_plies;
+  undo->plies_from_null = pos->plies_from_null;
+  undo->enpassant = pos->enpassant;
+
+  // the fifty move counter stays as it scales the evaluation. Only the side
+  // key changes, so positions from before the null move must not be taken
+  // for repetitions
+  pos->reversible_plies++;
+  pos->plies_from_null = 0;
+
+  // hash enpassant if available
+  if (pos->enpassant != no_sq)
+    pos->hash_key ^= keys.enpassant_keys[pos->enpassant];
+
+  // reset enpassant capture square
+  pos->enpassant = no_sq;
+
+  // switch the side, literally giving opponent an extra move to make
+  pos->side ^= 1;
+
+  // hash the side
+  pos->hash_key ^= keys.side_key;
+
+  update_check_info(pos);
+}
+
+// take back a null move
+void unmake_null_move(position_t *pos, undo_t *undo) {
+  pos->side ^= 1;
+  pos->hash_key = undo->hash_key;
+  pos->check_info = undo->check_info;
+  pos->reversible_plies = undo->reversible_plies;
+  pos->plies_from_null = undo->plies_from_null;
+  pos->enpassant = undo->enpassant;
 }
 
 // add move to the move list
@@ -277,742 +468,509 @@ void add_move(moves *move_list, int move) {
   move_list->count++;
 }
 
-void generate_captures(position_t *pos, moves *move_list) {
-  // init move count
-  move_list->count = 0;
+// generator stages, combined as a bit mask
+#define GEN_QUIETS 1
+#define GEN_CAPTURES 2
+#define GEN_QUIET_PROMOTIONS 4
+#define GEN_EVASIONS 8
+
+// target ranks of promotions and of the first push of a double push
+#define RANK_8 0x00000000000000FFULL
+#define RANK_6 0x0000000000FF0000ULL
+#define RANK_3 0x0000FF0000000000ULL
+#define RANK_1 0xFF00000000000000ULL
+
+// pawn bitboard shifts towards the promotion rank
+static FORCE_INLINE uint64_t shift_up(uint64_t bitboard, const uint8_t side) {
+  return side == white ? bitboard >> 8 : bitboard << 8;
+}
 
-  // define source & target squares
-  int source_square, target_square;
+// pawn captures towards the a file
+static FORCE_INLINE uint64_t shift_west(uint64_t bitboard,
+                                        const uint8_t side) {
+  return side == white ? (bitboard >> 9) & not_h_file
+                       : (bitboard << 7) & not_h_file;
+}
 
-  // define current piece's bitboard copy & its attacks
-  uint64_t bitboard, attacks;
-  uint8_t side = pos->side;
-  // loop over all the bitboards
-  for (uint8_t piece = P; piece <= k; piece++) {
-    // init piece bitboard copy
-    bitboard = pos->bitboards[piece];
+// pawn captures towards the h file
+static FORCE_INLINE uint64_t shift_east(uint64_t bitboard,
+                                        const uint8_t side) {
+  return side == white ? (bitboard >> 7) & not_a_file
+                       : (bitboard << 9) & not_a_file;
+}
 
-    // generate white pawns & white king castling moves
-    if (pos->side == white) {
-      // pick up white pawn bitboards index
-      if (piece == P) {
-        // loop over white pawns within white pawn bitboard
-        while (bitboard) {
-          // init source square
-          source_square = __builtin_ctzll(bitboard);
-
-          // init target square
-          target_square = source_square - 8;
-
-          // init pawn attacks bitboard
-          attacks = pawn_attacks[side][source_square] & pos->occupancies[black];
-
-          // generate pawn captures
-          while (attacks) {
-            // init target square
-            target_square = __builtin_ctzll(attacks);
-
-            // pawn promotion
-            if (source_square >= a7 && source_square <= h7) {
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  QUEEN_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  ROOK_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  BISHOP_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  KNIGHT_CAPTURE_PROMOTION));
-            }
-
-            else
-              // one square ahead pawn move
-              add_move(move_list,
-                       encode_move(source_square, target_square, CAPTURE));
-
-            // pop ls1b of the pawn attacks
-            pop_bit(attacks, target_square);
-          }
-
-          // generate enpassant captures
-          if (pos->enpassant != no_sq) {
-            // lookup pawn attacks and bitwise AND with enpassant square (bit)
-            uint64_t enpassant_attacks =
-                pawn_attacks[side][source_square] & (1ULL << pos->enpassant);
-
-            // make sure enpassant capture available
-            if (enpassant_attacks) {
-              // init enpassant capture target square
-              int target_enpassant = __builtin_ctzll(enpassant_attacks);
-              add_move(move_list,
-                       encode_move(source_square, target_enpassant,
-                                       ENPASSANT_CAPTURE));
-            }
-          }
-
-          // pop ls1b from piece bitboard copy
-          pop_bit(bitboard, source_square);
-        }
-      }
-    }
+// add pawn moves to every target square, the source is offset away
+static inline void add_pawn_moves(moves *move_list, uint64_t targets,
+                                  int offset, uint16_t flag) {
+  while (targets) {
+    int target_square = poplsb(&targets);
+    add_move(move_list,
+             encode_move(target_square - offset, target_square, flag));
+  }
+}
 
-    // generate black pawns & black king castling moves
-    else {
-      // pick up black pawn bitboards index
-      if (piece == p) {
-        // loop over white pawns within white pawn bitboard
-        while (bitboard) {
-          // init source square
-          source_square = __builtin_ctzll(bitboard);
-
-          // init target square
-          target_square = source_square + 8;
-
-          // init pawn attacks bitboard
-          attacks = pawn_attacks[side][source_square] & pos->occupancies[white];
-
-          // generate pawn captures
-          while (attacks) {
-            // init target square
-            target_square = __builtin_ctzll(attacks);
-
-            // pawn promotion
-            if (source_square >= a2 && source_square <= h2) {
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  QUEEN_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  ROOK_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  BISHOP_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  KNIGHT_CAPTURE_PROMOTION));
-            }
-
-            else
-              // one square ahead pawn move
-              add_move(move_list,
-                       encode_move(source_square, target_square, CAPTURE));
-
-            // pop ls1b of the pawn attacks
-            pop_bit(attacks, target_square);
-          }
-
-          // generate enpassant captures
-          if (pos->enpassant != no_sq) {
-            // lookup pawn attacks and bitwise AND with enpassant square (bit)
-            uint64_t enpassant_attacks =
-                pawn_attacks[side][source_square] & (1ULL << pos->enpassant);
-
-            // make sure enpassant capture available
-            if (enpassant_attacks) {
-              // init enpassant capture target square
-              int target_enpassant = __builtin_ctzll(enpassant_attacks);
-              add_move(move_list,
-                       encode_move(source_square, target_enpassant,
-                                       ENPASSANT_CAPTURE));
-            }
-          }
-
-          // pop ls1b from piece bitboard copy
-          pop_bit(bitboard, source_square);
-        }
-      }
-    }
+// add all four promotions of a pawn move
+static inline void add_promotions(moves *move_list, int source_square,
+                                  int target_square, uint8_t capture) {
+  uint16_t flag = capture ? CAPTURE : QUIET;
+  add_move(move_list,
+           encode_move(source_square, target_square, QUEEN_PROMOTION | flag));
+  add_move(move_list,
+           encode_move(source_square, target_square, ROOK_PROMOTION | flag));
+  add_move(move_list,
+           encode_move(source_square, target_square, BISHOP_PROMOTION | flag));
+  add_move(move_list,
+           encode_move(source_square, target_square, KNIGHT_PROMOTION | flag));
+}
 
-    // genarate knight moves
-    if ((side == white) ? piece == N : piece == n) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = knight_attacks[source_square] &
-                  ((side == white) ? ~pos->occupancies[white]
-                                   : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (get_bit(((side == white) ? pos->occupancies[black]
-                                       : pos->occupancies[white]),
-                      target_square))
-            add_move(move_list,
-                     encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
+// add promotions to every target square, the source is offset away
+static inline void add_pawn_promotions(moves *move_list, uint64_t targets,
+                                       int offset, uint8_t capture) {
+  while (targets) {
+    int target_square = poplsb(&targets);
+    add_promotions(move_list, target_square - offset, target_square, capture);
+  }
+}
+
+// add moves from source square to the target squares
+static inline void add_piece_moves(position_t *pos, moves *move_list,
+                                   int source_square, uint64_t targets) {
+  // loop over target squares
+  while (targets) {
+    // init target square
+    int target_square = poplsb(&targets);
+
+    // quiet move
+    if (!get_bit(pos->occupancies[both], target_square))
+      add_move(move_list, encode_move(source_square, target_square, QUIET));
+
+    else
+      // capture move
+      add_move(move_list, encode_move(source_square, target_square, CAPTURE));
+  }
+}
+
+// Generates pawn moves set-wise. Pinned pawns are rare and handled square by
+// square, en passant is tested against the resulting occupancy
+static FORCE_INLINE void generate_pawn_moves(position_t *pos,
+                                             moves *move_list,
+                                             uint64_t check_mask,
+                                             const uint8_t gen,
+                                             const uint8_t side) {
+  const int up = side == white ? -8 : 8;
+  const int west = side == white ? -9 : 7;
+  const int east = side == white ? -7 : 9;
+  const uint64_t promotion_rank = side == white ? RANK_8 : RANK_1;
+  const uint64_t double_push_rank = side == white ? RANK_3 : RANK_6;
+
+  uint64_t empty = ~pos->occupancies[both];
+  uint64_t enemies = pos->occupancies[side ^ 1];
+  uint64_t pawns = pos->bitboards[side == white ? P : p];
+  uint64_t pinned = pos->check_info.pinned[side];
+  uint64_t free_pawns = pawns & ~pinned;
+  int king_square = get_lsb(pos->bitboards[side == white ? K : k]);
+
+  // generate pawn captures
+  if (gen & GEN_CAPTURES) {
+    uint64_t west_captures =
+        shift_west(free_pawns, side) & enemies & check_mask;
+    uint64_t east_captures =
+        shift_east(free_pawns, side) & enemies & check_mask;
+
+    add_pawn_promotions(move_list, west_captures & promotion_rank, west, 1);
+    add_pawn_promotions(move_list, east_captures & promotion_rank, east, 1);
+    add_pawn_moves(move_list, west_captures & ~promotion_rank, west, CAPTURE);
+    add_pawn_moves(move_list, east_captures & ~promotion_rank, east, CAPTURE);
+  }
+
+  // generate pawn pushes
+  if (gen & (GEN_QUIETS | GEN_QUIET_PROMOTIONS)) {
+    uint64_t single_pushes = shift_up(free_pawns, side) & empty;
+
+    if (gen & GEN_QUIET_PROMOTIONS)
+      add_pawn_promotions(move_list,
+                          single_pushes & promotion_rank & check_mask, up,
+                          0);
+
+    if (gen & GEN_QUIETS) {
+      uint64_t double_pushes =
+          shift_up(single_pushes & double_push_rank, side) & empty;
+      add_pawn_moves(move_list,
+                     single_pushes & ~promotion_rank & check_mask, up,
+                     QUIET);
+      add_pawn_moves(move_list, double_pushes & check_mask, 2 * up,
+                     DOUBLE_PUSH);
     }
+  }
 
-    // generate bishop moves
-    if ((side == white) ? piece == B : piece == b) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = get_bishop_attacks(source_square, pos->occupancies[both]) &
-                  ((side == white) ? ~pos->occupancies[white]
-                                   : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (get_bit(((side == white) ? pos->occupancies[black]
-                                       : pos->occupancies[white]),
-                      target_square))
-            add_move(move_list,
-                     encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
+  // generate moves of pinned pawns
+  uint64_t pinned_pawns = pawns & pinned;
+  while (pinned_pawns) {
+    int source_square = poplsb(&pinned_pawns);
+    uint64_t legal_mask = check_mask & line_masks[king_square][source_square];
+    int target_square = source_square + up;
+
+    if (get_bit(empty, target_square) && get_bit(legal_mask, target_square)) {
+      if (get_bit(promotion_rank, target_square)) {
+        if (gen & GEN_QUIET_PROMOTIONS)
+          add_promotions(move_list, source_square, target_square, 0);
+      } else if (gen & GEN_QUIETS) {
+        add_move(move_list, encode_move(source_square, target_square, QUIET));
       }
     }
 
-    // generate rook moves
-    if ((side == white) ? piece == R : piece == r) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = get_rook_attacks(source_square, pos->occupancies[both]) &
-                  ((side == white) ? ~pos->occupancies[white]
-                                   : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (get_bit(((side == white) ? pos->occupancies[black]
-                                       : pos->occupancies[white]),
-                      target_square))
-            add_move(move_list,
-                     encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
+    if ((gen & GEN_QUIETS) && get_bit(empty, target_square) &&
+        get_bit(double_push_rank, target_square) &&
+        get_bit(empty, target_square + up) &&
+        get_bit(legal_mask, target_square + up))
+      add_move(move_list, encode_move(source_square, target_square + up,
+                                      DOUBLE_PUSH));
+
+    if (gen & GEN_CAPTURES) {
+      uint64_t attacks =
+          pawn_attacks[side][source_square] & enemies & legal_mask;
+      while (attacks) {
+        target_square = poplsb(&attacks);
+        if (get_bit(promotion_rank, target_square))
+          add_promotions(move_list, source_square, target_square, 1);
+        else
+          add_move(move_list,
+                   encode_move(source_square, target_square, CAPTURE));
       }
     }
+  }
 
-    // generate queen moves
-    if ((side == white) ? piece == Q : piece == q) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = get_queen_attacks(source_square, pos->occupancies[both]) &
-                  ((side == white) ? ~pos->occupancies[white]
-                                   : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (get_bit(((side == white) ? pos->occupancies[black]
-                                       : pos->occupancies[white]),
-                      target_square))
-            add_move(move_list,
-                     encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
+  // generate enpassant captures
+  if ((gen & GEN_CAPTURES) && pos->enpassant != no_sq) {
+    uint64_t captured = 1ULL << (pos->enpassant - up);
+    uint64_t attackers = pawns & pawn_attacks[side ^ 1][pos->enpassant];
+    while (attackers) {
+      int source_square = poplsb(&attackers);
+
+      // both pawns leave their squares so test the king directly on the
+      // resulting occupancy
+      uint64_t occupancy =
+          (pos->occupancies[both] ^ (1ULL << source_square) ^ captured) |
+          (1ULL << pos->enpassant);
+      if (!(all_attackers_to_square(pos, occupancy, king_square) & enemies &
+            ~captured))
+        add_move(move_list, encode_move(source_square, pos->enpassant,
+                                        ENPASSANT_CAPTURE));
     }
+  }
+}
 
-    // generate king moves
-    if ((side == white) ? piece == K : piece == k) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = king_attacks[source_square] &
-                  ((side == white) ? ~pos->occupancies[white]
-                                   : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (get_bit(((side == white) ? pos->occupancies[black]
-                                       : pos->occupancies[white]),
-                      target_square))
-            add_move(move_list,
-                     encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
+// generate moves of knights, bishops, rooks or queens
+static FORCE_INLINE void generate_piece_moves(position_t *pos,
+                                              moves *move_list,
+                                              uint64_t targets,
+                                              const uint8_t piece_type,
+                                              const uint8_t side) {
+  uint64_t bitboard = pos->bitboards[side == white ? piece_type
+                                                   : piece_type + 6];
+  uint64_t pinned = pos->check_info.pinned[side];
+
+  // pinned knights can never move
+  if (piece_type == KNIGHT)
+    bitboard &= ~pinned;
+
+  // loop over source squares of piece bitboard copy
+  while (bitboard) {
+    // init source square
+    int source_square = poplsb(&bitboard);
+
+    // init piece attacks in order to get set of target squares
+    uint64_t attacks;
+    if (piece_type == KNIGHT)
+      attacks = knight_attacks[source_square];
+    else if (piece_type == BISHOP)
+      attacks = get_bishop_attacks(source_square, pos->occupancies[both]);
+    else if (piece_type == ROOK)
+      attacks = get_rook_attacks(source_square, pos->occupancies[both]);
+    else
+      attacks = get_queen_attacks(source_square, pos->occupancies[both]);
+
+    // pinned pieces may only move along the line through their king
+    attacks &= targets;
+    if (get_bit(pinned, source_square))
+      attacks &= line_masks[get_lsb(pos->bitboards[side == white ? K : k])]
+                           [source_square];
+
+    add_piece_moves(pos, move_list, source_square, attacks);
+  }
+}
+
+// add a castling move if the rook is there, the path is empty and the king
+// does not pass or land on attacked squares
+static FORCE_INLINE void add_castling(position_t *pos, moves *move_list,
+                                      uint8_t right, uint64_t path,
+                                      int king_square, int pass_square,
+                                      int target_square, uint16_t flag,
+                                      const uint8_t side) {
+  if ((pos->castle & right) && !(pos->occupancies[both] & path) &&
+      !is_square_attacked(pos, pass_square, side ^ 1) &&
+      !is_square_attacked(pos, target_square, side ^ 1))
+    add_move(move_list, encode_move(king_square, target_square, flag));
+}
+
+// generate king moves and castling
+static FORCE_INLINE void generate_king_moves(position_t *pos,
+                                             moves *move_list,
+                                             uint64_t targets,
+                                             const uint8_t gen,
+                                             const uint8_t side) {
+  // castling moves
+  if ((gen & GEN_QUIETS) && !(gen & GEN_EVASIONS) &&
+      !pos->check_info.checkers) {
+    if (side == white) {
+      add_castling(pos, move_list, wk, (1ULL << f1) | (1ULL << g1), e1, f1,
+                   g1, KING_CASTLE, side);
+      add_castling(pos, move_list, wq,
+                   (1ULL << d1) | (1ULL << c1) | (1ULL << b1), e1, d1, c1,
+                   QUEEN_CASTLE, side);
+    } else {
+      add_castling(pos, move_list, bk, (1ULL << f8) | (1ULL << g8), e8, f8,
+                   g8, KING_CASTLE, side);
+      add_castling(pos, move_list, bq,
+                   (1ULL << d8) | (1ULL << c8) | (1ULL << b8), e8, d8, c8,
+                   QUEEN_CASTLE, side);
     }
   }
+
+  // the king may not step onto attacked squares, including squares it only
+  // shields from a slider itself
+  int source_square = get_lsb(pos->bitboards[side == white ? K : k]);
+  uint64_t occupancy = pos->occupancies[both] ^ (1ULL << source_square);
+  uint64_t attacks = king_attacks[source_square] & targets;
+  uint64_t safe = 0ULL;
+  while (attacks) {
+    int target_square = poplsb(&attacks);
+    if (!(all_attackers_to_square(pos, occupancy, target_square) &
+          pos->occupancies[side ^ 1]))
+      set_bit(safe, target_square);
+  }
+
+  add_piece_moves(pos, move_list, source_square, safe);
 }
 
-// generate all moves
-void generate_moves(position_t *pos, moves *move_list) {
+// Generates the legal moves of the requested stages for one side. Both the
+// stages and the side are compile time constants in every caller, so each
+// generator gets its own specialized copy
+static FORCE_INLINE void generate(position_t *pos, moves *move_list,
+                                  const uint8_t gen, const uint8_t side) {
   // init move count
   move_list->count = 0;
 
-  // define source & target squares
-  int source_square, target_square;
+  // squares a non king move has to land on, a double check leaves only king
+  // moves
+  uint64_t checkers = pos->check_info.checkers;
+  uint64_t check_mask = ~0ULL;
+  if (checkers & (checkers - 1))
+    check_mask = 0ULL;
+  else if (checkers)
+    check_mask =
+        checkers |
+        between_masks[get_lsb(pos->bitboards[side == white ? K : k])]
+                     [get_lsb(checkers)];
+
+  // target squares of the requested stages
+  uint64_t targets = 0ULL;
+  if (gen & GEN_CAPTURES)
+    targets |= pos->occupancies[side ^ 1];
+  if (gen & GEN_QUIETS)
+    targets |= ~pos->occupancies[both];
+
+  // only the king can move out of a double check
+  if (check_mask) {
+    uint64_t piece_targets = targets & check_mask;
+    generate_pawn_moves(pos, move_list, check_mask, gen, side);
+    generate_piece_moves(pos, move_list, piece_targets, KNIGHT, side);
+    generate_piece_moves(pos, move_list, piece_targets, BISHOP, side);
+    generate_piece_moves(pos, move_list, piece_targets, ROOK, side);
+    generate_piece_moves(pos, move_list, piece_targets, QUEEN, side);
+  }
 
-  // define current piece's bitboard copy & its attacks
-  uint64_t bitboard, attacks;
+  generate_king_moves(pos, move_list, targets, gen, side);
+}
 
-  // loop over all the bitboards
-  for (uint8_t piece = P; piece <= k; piece++) {
-    // init piece bitboard copy
-    bitboard = pos->bitboards[piece];
+// instantiate a generator for both sides to move
+#define DEFINE_GENERATOR(name, gen)                                            \
+  void name(position_t *pos, moves *move_list) {                               \
+    if (pos->side == white)                                                    \
+      generate(pos, move_list, gen, white);                                    \
+    else                                                                       \
+      generate(pos, move_list, gen, black);                                    \
+  }
 
-    // generate white pawns & white king castling moves
-    if (pos->side == white) {
-      // pick up white pawn bitboards index
-      if (piece == P) {
-        // loop over white pawns within white pawn bitboard
-        while (bitboard) {
-          // init source square
-          source_square = __builtin_ctzll(bitboard);
-
-          // init target square
-          target_square = source_square - 8;
-
-          // generate quiet pawn moves
-          if (!(target_square < a8) &&
-              !get_bit(pos->occupancies[both], target_square)) {
-            // pawn promotion
-            if (source_square >= a7 && source_square <= h7) {
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  QUEEN_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  ROOK_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  BISHOP_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  KNIGHT_PROMOTION));
-            }
-
-            else {
-              // one square ahead pawn move
-              add_move(move_list,
-                       encode_move(source_square, target_square, QUIET));
-
-              // two squares ahead pawn move
-              if ((source_square >= a2 && source_square <= h2) &&
-                  !get_bit(pos->occupancies[both], target_square - 8))
-                add_move(move_list,
-                         encode_move(source_square, (target_square - 8),
-                                         DOUBLE_PUSH));
-            }
-          }
-
-          // init pawn attacks bitboard
-          attacks =
-              pawn_attacks[pos->side][source_square] & pos->occupancies[black];
-
-          // generate pawn captures
-          while (attacks) {
-            // init target square
-            target_square = __builtin_ctzll(attacks);
-
-            // pawn promotion
-            if (source_square >= a7 && source_square <= h7) {
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  QUEEN_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  ROOK_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  BISHOP_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square,
-                                                  KNIGHT_CAPTURE_PROMOTION));
-            }
-
-            else
-              // one square ahead pawn move
-              add_move(move_list,
-                       encode_move(source_square, target_square, CAPTURE));
-
-            // pop ls1b of the pawn attacks
-            pop_bit(attacks, target_square);
-          }
-
-          // generate enpassant captures
-          if (pos->enpassant != no_sq) {
-            // lookup pawn attacks and bitwise AND with enpassant square (bit)
-            uint64_t enpassant_attacks =
-                pawn_attacks[pos->side][source_square] &
-                (1ULL << pos->enpassant);
-
-            // make sure enpassant capture available
-            if (enpassant_attacks) {
-              // init enpassant capture target square
-              int target_enpassant = __builtin_ctzll(enpassant_attacks);
-              add_move(move_list,
-                       encode_move(source_square, target_enpassant,
-                                       ENPASSANT_CAPTURE));
-            }
-          }
-
-          // pop ls1b from piece bitboard copy
-          pop_bit(bitboard, source_square);
-        }
-      }
+// generate captures, enpassant and capture promotions
+DEFINE_GENERATOR(generate_captures, GEN_CAPTURES)
 
-      // castling moves
-      if (piece == K) {
-        // king side castling is available
-        if (pos->castle & wk) {
-          // make sure square between king and king's rook are empty
-          if (!get_bit(pos->occupancies[both], f1) &&
-              !get_bit(pos->occupancies[both], g1)) {
-            // make sure king and the f1 squares are not under attacks
-            if (!is_square_attacked(pos, e1, black) &&
-                !is_square_attacked(pos, f1, black))
-              add_move(move_list, encode_move(e1, g1, KING_CASTLE));
-          }
-        }
-
-        // queen side castling is available
-        if (pos->castle & wq) {
-          // make sure square between king and queen's rook are empty
-          if (!get_bit(pos->occupancies[both], d1) &&
-              !get_bit(pos->occupancies[both], c1) &&
-              !get_bit(pos->occupancies[both], b1)) {
-            // make sure king and the d1 squares are not under attacks
-            if (!is_square_attacked(pos, e1, black) &&
-                !is_square_attacked(pos, d1, black))
-              add_move(move_list, encode_move(e1, c1, QUEEN_CASTLE));
-          }
-        }
-      }
-    }
+// generate captures and all promotions
+DEFINE_GENERATOR(generate_noisy, GEN_CAPTURES | GEN_QUIET_PROMOTIONS)
 
-    // generate black pawns & black king castling moves
-    else {
-      // pick up black pawn bitboards index
-      if (piece == p) {
-        // loop over white pawns within white pawn bitboard
-        while (bitboard) {
-          // init source square
-          source_square = __builtin_ctzll(bitboard);
-
-          // init target square
-          target_square = source_square + 8;
-
-          // generate quiet pawn moves
-          if (!(target_square > h1) &&
-              !get_bit(pos->occupancies[both], target_square)) {
-            // pawn promotion
-            if (source_square >= a2 && source_square <= h2) {
-              add_move(move_list, encode_move(source_square, target_square, QUEEN_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square, ROOK_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square, BISHOP_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square, KNIGHT_PROMOTION));
-            }
-
-            else {
-              // one square ahead pawn move
-              add_move(move_list, encode_move(source_square, target_square,
-                                              QUIET));
-
-              // two squares ahead pawn move
-              if ((source_square >= a7 && source_square <= h7) &&
-                  !get_bit(pos->occupancies[both], target_square + 8))
-                add_move(move_list,
-                         encode_move(source_square, (target_square + 8), DOUBLE_PUSH));
-            }
-          }
-
-          // init pawn attacks bitboard
-          attacks =
-              pawn_attacks[pos->side][source_square] & pos->occupancies[white];
-
-          // generate pawn captures
-          while (attacks) {
-            // init target square
-            target_square = __builtin_ctzll(attacks);
-
-            // pawn promotion
-            if (source_square >= a2 && source_square <= h2) {
-              add_move(move_list, encode_move(source_square, target_square, QUEEN_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square, ROOK_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square, BISHOP_CAPTURE_PROMOTION));
-              add_move(move_list, encode_move(source_square, target_square, KNIGHT_CAPTURE_PROMOTION));
-            }
-
-            else
-              // one square ahead pawn move
-              add_move(move_list, encode_move(source_square, target_square,
-                                              CAPTURE));
-
-            // pop ls1b of the pawn attacks
-            pop_bit(attacks, target_square);
-          }
-
-          // generate enpassant captures
-          if (pos->enpassant != no_sq) {
-            // lookup pawn attacks and bitwise AND with enpassant square (bit)
-            uint64_t enpassant_attacks =
-                pawn_attacks[pos->side][source_square] &
-                (1ULL << pos->enpassant);
-
-            // make sure enpassant capture available
-            if (enpassant_attacks) {
-              // init enpassant capture target square
-              int target_enpassant = __builtin_ctzll(enpassant_attacks);
-              add_move(move_list, encode_move(source_square, target_enpassant,
-                                              ENPASSANT_CAPTURE));
-            }
-          }
-
-          // pop ls1b from piece bitboard copy
-          pop_bit(bitboard, source_square);
-        }
-      }
+// generate quiet moves including castling but no promotions
+DEFINE_GENERATOR(generate_quiets, GEN_QUIETS)
 
-      // castling moves
-      if (piece == k) {
-        // king side castling is available
-        if (pos->castle & bk) {
-          // make sure square between king and king's rook are empty
-          if (!get_bit(pos->occupancies[both], f8) &&
-              !get_bit(pos->occupancies[both], g8)) {
-            // make sure king and the f8 squares are not under attacks
-            if (!is_square_attacked(pos, e8, white) &&
-                !is_square_attacked(pos, f8, white))
-              add_move(move_list, encode_move(e8, g8, KING_CASTLE));
-          }
-        }
-
-        // queen side castling is available
-        if (pos->castle & bq) {
-          // make sure square between king and queen's rook are empty
-          if (!get_bit(pos->occupancies[both], d8) &&
-              !get_bit(pos->occupancies[both], c8) &&
-              !get_bit(pos->occupancies[both], b8)) {
-            // make sure king and the d8 squares are not under attacks
-            if (!is_square_attacked(pos, e8, white) &&
-                !is_square_attacked(pos, d8, white))
-              add_move(move_list, encode_move(e8, c8, QUEEN_CASTLE));
-          }
-        }
-      }
-    }
+// generate all moves
+DEFINE_GENERATOR(generate_moves,
+                 GEN_QUIETS | GEN_CAPTURES | GEN_QUIET_PROMOTIONS)
+
+// Generates king moves, captures of the checker and interpositions. Only
+// valid when the side to move is in check
+DEFINE_GENERATOR(generate_evasions, GEN_QUIETS | GEN_CAPTURES |
+                                        GEN_QUIET_PROMOTIONS | GEN_EVASIONS)
+
+// castling as generated by add_castling: rights, empty path and a king that
+// neither starts in, passes through nor lands on an attacked square
+static inline uint8_t is_castling_pseudo_legal(position_t *pos, uint16_t move) {
+  int side = pos->side;
+  int source_square = get_move_source(move);
+  int target_square = get_move_target(move);
+  uint8_t king_side = (move & 15) == KING_CASTLE;
+  uint8_t right = side == white ? (king_side ? wk : wq) : (king_side ? bk : bq);
+  int king_square = side == white ? e1 : e8;
+  int pass_square = king_side ? king_square + 1 : king_square - 1;
+  uint64_t path = king_side ? (1ULL << (king_square + 1)) |
+                                  (1ULL << (king_square + 2))
+                            : (1ULL << (king_square - 1)) |
+                                  (1ULL << (king_square - 2)) |
+                                  (1ULL << (king_square - 3));
+
+  return source_square == king_square &&
+         target_square == (king_side ? king_square + 2 : king_square - 2) &&
+         (pos->castle & right) && !pos->check_info.checkers &&
+         !(pos->occupancies[both] & path) &&
+         !is_square_attacked(pos, pass_square, side ^ 1) &&
+         !is_square_attacked(pos, target_square, side ^ 1);
+}
 
-    // genarate knight moves
-    if ((pos->side == white) ? piece == N : piece == n) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = knight_attacks[source_square] &
-                  ((pos->side == white) ? ~pos->occupancies[white]
-                                        : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (!get_bit(((pos->side == white) ? pos->occupancies[black]
-                                             : pos->occupancies[white]),
-                       target_square))
-            add_move(move_list, encode_move(source_square, target_square, QUIET));
-
-          else
-            // capture move
-            add_move(move_list, encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
-    }
+// Tests if a move, usually from the hash table, is one the generator could
+// produce in this position, including the check evasion rules. Pins and the
+// safety of the destination of a king move are not tested
+uint8_t is_pseudo_legal(position_t *pos, uint16_t move) {
+  int side = pos->side;
+  int source_square = get_move_source(move);
+  int target_square = get_move_target(move);
+  int flag = move & 15;
+  uint8_t piece = pos->mailbox[source_square];
 
-    // generate bishop moves
-    if ((pos->side == white) ? piece == B : piece == b) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = get_bishop_attacks(source_square, pos->occupancies[both]) &
-                  ((pos->side == white) ? ~pos->occupancies[white]
-                                        : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (!get_bit(((pos->side == white) ? pos->occupancies[black]
-                                             : pos->occupancies[white]),
-                       target_square))
-            add_move(move_list, encode_move(source_square, target_square, QUIET));
-
-          else
-            // capture move
-            add_move(move_list, encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
-    }
+  // the moving piece has to belong to the side to move, flags 6 and 7 are
+  // never generated
+  if (!move || piece == NO_PIECE || (piece >= p) != side || flag == 6 ||
+      flag == 7)
+    return 0;
 
-    // generate rook moves
-    if ((pos->side == white) ? piece == R : piece == r) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = get_rook_attacks(source_square, pos->occupancies[both]) &
-                  ((pos->side == white) ? ~pos->occupancies[white]
-                                        : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (!get_bit(((pos->side == white) ? pos->occupancies[black]
-                                             : pos->occupancies[white]),
-                       target_square))
-            add_move(move_list, encode_move(source_square, target_square, QUIET));
-
-          else
-            // capture move
-            add_move(move_list, encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
-    }
+  int piece_type = piece % 6;
+  uint64_t target = 1ULL << target_square;
+
+  if (get_move_castling(move))
+    return piece_type == KING && is_castling_pseudo_legal(pos, move);
+
+  // captures land on an enemy piece, every other move on an empty square
+  if (get_move_enpassant(move)) {
+    if (piece_type != PAWN || target_square != pos->enpassant ||
+        pos->enpassant == no_sq)
+      return 0;
+  } else if (get_move_capture(move)) {
+    if (!(pos->occupancies[side ^ 1] & target))
+      return 0;
+  } else if (pos->occupancies[both] & target) {
+    return 0;
+  }
 
-    // generate queen moves
-    if ((pos->side == white) ? piece == Q : piece == q) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = get_queen_attacks(source_square, pos->occupancies[both]) &
-                  ((pos->side == white) ? ~pos->occupancies[white]
-                                        : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (!get_bit(((pos->side == white) ? pos->occupancies[black]
-                                             : pos->occupancies[white]),
-                       target_square))
-            add_move(move_list, encode_move(source_square, target_square, QUIET));
-
-          else
-            // capture move
-            add_move(move_list, encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
+  if (piece_type == PAWN) {
+    const int up = side == white ? -8 : 8;
+    const uint64_t promotion_rank = side == white ? RANK_8 : RANK_1;
+    const uint64_t double_push_rank = side == white ? RANK_3 : RANK_6;
+
+    // pawns promote exactly when they reach the last rank
+    if (!is_move_promotion(move) != !(target & promotion_rank))
+      return 0;
+
+    if (get_move_capture(move)) {
+      if (!(pawn_attacks[side][source_square] & target))
+        return 0;
+    } else if (get_move_double(move)) {
+      if (target_square != source_square + 2 * up ||
+          !get_bit(double_push_rank, source_square + up) ||
+          get_bit(pos->occupancies[both], source_square + up))
+        return 0;
+    } else if (target_square != source_square + up) {
+      return 0;
     }
+  } else {
+    if (is_move_promotion(move) || get_move_double(move) ||
+        get_move_enpassant(move))
+      return 0;
+
+    uint64_t attacks;
+    if (piece_type == KNIGHT)
+      attacks = knight_attacks[source_square];
+    else if (piece_type == BISHOP)
+      attacks = get_bishop_attacks(source_square, pos->occupancies[both]);
+    else if (piece_type == ROOK)
+      attacks = get_rook_attacks(source_square, pos->occupancies[both]);
+    else if (piece_type == QUEEN)
+      attacks = get_queen_attacks(source_square, pos->occupancies[both]);
+    else
+      attacks = king_attacks[source_square];
+
+    if (!(attacks & target))
+      return 0;
+  }
 
-    // generate king moves
-    if ((pos->side == white) ? piece == K : piece == k) {
-      // loop over source squares of piece bitboard copy
-      while (bitboard) {
-        // init source square
-        source_square = __builtin_ctzll(bitboard);
-
-        // init piece attacks in order to get set of target squares
-        attacks = king_attacks[source_square] &
-                  ((pos->side == white) ? ~pos->occupancies[white]
-                                        : ~pos->occupancies[black]);
-
-        // loop over target squares available from generated attacks
-        while (attacks) {
-          // init target square
-          target_square = __builtin_ctzll(attacks);
-
-          // quiet move
-          if (!get_bit(((pos->side == white) ? pos->occupancies[black]
-                                             : pos->occupancies[white]),
-                       target_square))
-            add_move(move_list, encode_move(source_square, target_square, QUIET));
-
-          else
-            // capture move
-            add_move(move_list, encode_move(source_square, target_square, CAPTURE));
-
-          // pop ls1b in current attacks set
-          pop_bit(attacks, target_square);
-        }
-
-        // pop ls1b of the current piece bitboard copy
-        pop_bit(bitboard, source_square);
-      }
-    }
+  // in check a non king move has to capture the checker or block the check,
+  // an en passant capture may also remove a checking pawn
+  uint64_t checkers = pos->check_info.checkers;
+  if (checkers && piece_type != KING) {
+    if (checkers & (checkers - 1))
+      return 0;
+
+    int king_square = get_lsb(pos->bitboards[side == white ? K : k]);
+    uint64_t check_mask =
+        checkers | between_masks[king_square][get_lsb(checkers)];
+    if (get_move_enpassant(move) &&
+        get_bit(checkers, target_square - (side == white ? -8 : 8)))
+      return 1;
+    if (!(check_mask & target))
+      return 0;
+  }
+
+  return 1;
+}
+
+// Tells if a pseudo legal move leaves the own king safe, using the pins of
+// the position instead of making the move
+uint8_t is_legal(position_t *pos, uint16_t move) {
+  int side = pos->side;
+  int source_square = get_move_source(move);
+  int target_square = get_move_target(move);
+  int king_square = get_lsb(pos->bitboards[side == white ? K : k]);
+  uint64_t enemies = pos->occupancies[side ^ 1];
+
+  // is_pseudo_legal already checked every square the king crosses
+  if (get_move_castling(move))
+    return 1;
+
+  // the king may not step onto a square it only shields from a slider itself
+  if (source_square == king_square)
+    return !(all_attackers_to_square(
+                 pos, pos->occupancies[both] ^ (1ULL << source_square),
+                 target_square) &
+             enemies);
+
+  // both pawns leave their squares so test the king directly on the
+  // resulting occupancy
+  if (get_move_enpassant(move)) {
+    uint64_t captured = 1ULL << (target_square - (side == white ? -8 : 8));
+    uint64_t occupancy =
+        (pos->occupancies[both] ^ (1ULL << source_square) ^ captured) |
+        (1ULL << target_square);
+    return !(all_attackers_to_square(pos, occupancy, king_square) & enemies &
+             ~captured);
   }
+
+  // pinned pieces may only move along the line through their king
+  return !get_bit(pos->check_info.pinned[side], source_square) ||
+         get_bit(line_masks[king_square][source_square], target_square);
 }
@@ -4,8 +4,17 @@
 #include "structs.h"
 
 void add_move(moves *move_list, int move);
-int make_move(position_t* pos, int move, int move_flag);
+void update_check_info(position_t *pos);
+int make_move(position_t* pos, int move, int move_flag, undo_t *undo);
+void unmake_move(position_t* pos, int move, undo_t *undo);
+void make_null_move(position_t* pos, undo_t *undo);
+void unmake_null_move(position_t* pos, undo_t *undo);
 void generate_moves(position_t* pos, moves *move_list);
 void generate_captures(position_t* pos, moves *move_list);
+void generate_noisy(position_t* pos, moves *move_list);
+void generate_quiets(position_t* pos, moves *move_list);
+void generate_evasions(position_t* pos, moves *move_list);
+uint8_t is_pseudo_legal(position_t *pos, uint16_t move);
+uint8_t is_legal(position_t *pos, uint16_t move);
 
 #endif
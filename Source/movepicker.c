@@ -0,0 +1,239 @@
+#include "movepicker.h"
+#include "enums.h"
+#include "history.h"
+#include "move.h"
+#include "movegen.h"
+#include "see.h"
+#include "structs.h"
+#include "utils.h"
+#include <limits.h>
+#include <stdint.h>
+
+extern int mvv[];
+extern int MO_SEE_THRESHOLD;
+
+// Noisy moves start in the good band and drop to the bad band once they fail
+// their SEE check, which is only done when they are about to be picked
+#define GOOD_PROMOTION_SCORE 1400000000
+#define GOOD_CAPTURE_SCORE 1000000000
+#define BAD_NOISY_SCORE -1000000
+
+// score of moves that were already returned by the picker
+#define PICKED_SCORE INT_MIN
+
+// score noisy move
+static inline void score_noisy(position_t *pos, thread_t *thread,
+                               move_t *move_entry) {
+  uint16_t move = move_entry->move;
+  uint8_t piece = get_move_promoted(pos->side, move);
+
+  if (piece) {
+    // only queen and knight capture promotions are worth trying early
+    if (get_move_capture(move) && (piece == Q || piece == q))
+      move_entry->score = GOOD_PROMOTION_SCORE + 1;
+    else if (get_move_capture(move) && (piece == N || piece == n))
+      move_entry->score = GOOD_PROMOTION_SCORE;
+    else
+      move_entry->score = BAD_NOISY_SCORE;
+    return;
+  }
+
+  // init target piece
+  int target_piece = P;
+
+  uint8_t bb_piece = pos->mailbox[get_move_target(move)];
+  // if there's a piece on the target square
+  if (bb_piece != NO_PIECE &&
+      get_bit(pos->bitboards[bb_piece], get_move_target(move))) {
+    target_piece = bb_piece;
+  }
+
+  // score move by MVV lookup and capture history
+  move_entry->score =
+      GOOD_CAPTURE_SCORE + mvv[target_piece > 5 ? target_piece - 6 : target_piece] +
+      *capture_history_entry(thread, pos, move);
+}
+
+// score quiet move
+static inline void score_quiet(position_t *pos, thread_t *thread,
+                               searchstack_t *ss, move_t *move_entry) {
+  uint16_t move = move_entry->move;
+  move_entry->score =
+      thread->quiet_history[pos->mailbox[get_move_source(move)]]
+                           [get_move_source(move)][get_move_target(move)] +
+      get_conthist_score(thread, ss - 1, move) +
+      get_conthist_score(thread, ss - 2, move) +
+      get_conthist_score(thread, ss - 4, move);
+}
+
+static inline void generate_noisy_moves(movepicker_t *picker,
+                                        position_t *pos) {
+  if (picker->captures_only)
+    generate_captures(pos, picker->noisy);
+  else
+    generate_noisy(pos, picker->noisy);
+}
+
+// Generates all evasions at once and splits them into noisy and quiet moves,
+// keeping the order each of the stage generators would produce
+static inline void generate_evasion_moves(movepicker_t *picker,
+                                          position_t *pos) {
+  generate_evasions(pos, picker->noisy);
+
+  uint32_t noisy_count = 0;
+  picker->quiets->count = 0;
+  for (uint32_t count = 0; count < picker->noisy->count; count++) {
+    uint16_t move = picker->noisy->entry[count].move;
+    if (get_move_capture(move) || is_move_promotion(move))
+      picker->noisy->entry[noisy_count++].move = move;
+    else
+      add_move(picker->quiets, move);
+  }
+  picker->noisy->count = noisy_count;
+}
+
+// Finds the first move with the highest score that was not picked yet, so
+// equally scored moves come out in generation order
+static inline int best_index(moves *move_list) {
+  int best = -1;
+  int best_score = PICKED_SCORE;
+  for (uint32_t count = 0; count < move_list->count; count++) {
+    if (move_list->entry[count].score > best_score) {
+      best_score = move_list->entry[count].score;
+      best = count;
+    }
+  }
+  return best;
+}
+
+// Marks a specific move as picked, returns 0 if it is not in the list
+static inline uint8_t take_move(moves *move_list, uint16_t move) {
+  for (uint32_t count = 0; count < move_list->count; count++) {
+    if (move_list->entry[count].move == move &&
+        move_list->entry[count].score != PICKED_SCORE) {
+      move_list->entry[count].score = PICKED_SCORE;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Moves are generated and scored together right after the hash move, since
+// the histories change while earlier moves are searched. SEE checks and
+// selection are done lazily
+static inline void generate_picker_moves(movepicker_t *picker,
+                                         position_t *pos, thread_t *thread,
+                                         searchstack_t *ss) {
+  uint8_t captures_only = picker->captures_only;
+
+  if (picker->in_check && !captures_only)
+    generate_evasion_moves(picker, pos);
+  else {
+    generate_noisy_moves(picker, pos);
+    picker->quiets->count = 0;
+    if (!captures_only)
+      generate_quiets(pos, picker->quiets);
+  }
+
+  for (uint32_t count = 0; count < picker->noisy->count; count++)
+    score_noisy(pos, thread, &picker->noisy->entry[count]);
+
+  for (uint32_t count = 0; count < picker->quiets->count; count++)
+    score_quiet(pos, thread, ss, &picker->quiets->entry[count]);
+
+  // the hash move was already returned
+  if (picker->tt_move && !take_move(picker->noisy, picker->tt_move))
+    take_move(picker->quiets, picker->tt_move);
+}
+
+void init_picker(movepicker_t *picker, position_t *pos, thread_t *thread,
+                 searchstack_t *ss, uint16_t tt_move, uint8_t captures_only,
+                 uint8_t in_check) {
+  picker->killer = captures_only ? 0 : thread->killer_moves[pos->ply];
+  picker->stage = STAGE_TT;
+  picker->captures_only = captures_only;
+  picker->in_check = in_check;
+  picker->skip_quiets = 0;
+  picker->thread = thread;
+  picker->ss = ss;
+
+  // a hash move that is not a move of this position, or not one of the
+  // requested kind, is dropped before any move is generated
+  picker->tt_move =
+      tt_move && (!captures_only || get_move_capture(tt_move)) &&
+              is_pseudo_legal(pos, tt_move) && is_legal(pos, tt_move)
+          ? tt_move
+          : 0;
+}
+
+// Returns the next move to search or 0 once all stages are exhausted
+uint16_t next_move(movepicker_t *picker, position_t *pos) {
+  for (;;) {
+    switch (picker->stage) {
+    case STAGE_TT:
+      picker->stage = STAGE_GENERATE;
+      if (picker->tt_move)
+        return picker->tt_move;
+      break;
+
+    case STAGE_GENERATE:
+      generate_picker_moves(picker, pos, picker->thread, picker->ss);
+      picker->stage = STAGE_GOOD_NOISY;
+      break;
+
+    case STAGE_GOOD_NOISY: {
+      int index;
+      while ((index = best_index(picker->noisy)) != -1 &&
+             picker->noisy->entry[index].score >= GOOD_CAPTURE_SCORE / 2) {
+        move_t *entry = &picker->noisy->entry[index];
+        if (SEE(pos, entry->move, -MO_SEE_THRESHOLD)) {
+          entry->score = PICKED_SCORE;
+          return entry->move;
+        }
+
+        // losing noisy moves are tried after the quiet moves
+        entry->score =
+            is_move_promotion(entry->move)
+                ? BAD_NOISY_SCORE
+                : entry->score - GOOD_CAPTURE_SCORE + BAD_NOISY_SCORE;
+      }
+
+      picker->stage = picker->captures_only ? STAGE_BAD_NOISY : STAGE_KILLER;
+      break;
+    }
+
+    case STAGE_KILLER:
+      picker->stage = STAGE_QUIETS;
+      if (picker->skip_quiets || !picker->killer)
+        break;
+
+      if (take_move(picker->quiets, picker->killer))
+        return picker->killer;
+      break;
+
+    case STAGE_QUIETS:
+      if (!picker->skip_quiets) {
+        int index = best_index(picker->quiets);
+        if (index != -1) {
+          picker->quiets->entry[index].score = PICKED_SCORE;
+          return picker->quiets->entry[index].move;
+        }
+      }
+      picker->stage = STAGE_BAD_NOISY;
+      break;
+
+    case STAGE_BAD_NOISY: {
+      int index = best_index(picker->noisy);
+      if (index != -1) {
+        picker->noisy->entry[index].score = PICKED_SCORE;
+        return picker->noisy->entry[index].move;
+      }
+      picker->stage = STAGE_DONE;
+      break;
+    }
+
+    default:
+      return 0;
+    }
+  }
+}
@@ -0,0 +1,11 @@
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+
+#include "structs.h"
+
+void init_picker(movepicker_t *picker, position_t *pos, thread_t *thread,
+                 searchstack_t *ss, uint16_t tt_move, uint8_t captures_only,
+                 uint8_t in_check);
+uint16_t next_move(movepicker_t *picker, position_t *pos);
+
+#endif
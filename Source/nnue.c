@@ -347,10 +347,10 @@ static inline void accumulator_addaddsubsub(accumulator_t *accumulator,
 
 void accumulator_make_move(accumulator_t *accumulator,
                            accumulator_t *prev_accumulator, uint8_t side,
-                           int move, uint8_t *mailbox) {
+                           int move, uint8_t moving_piece,
+                           uint8_t captured_piece) {
   int from = get_move_source(move);
   int to = get_move_target(move);
-  int moving_piece = mailbox[from];
   int promoted_piece = get_move_promoted(!side, move);
   int capture = get_move_capture(move);
   int enpass = get_move_enpassant(move);
@@ -359,7 +359,6 @@ void accumulator_make_move(accumulator_t *accumulator,
   if (promoted_piece) {
     uint8_t pawn = side == 0 ? p : P;
     if (capture) {
-      uint8_t captured_piece = mailbox[to];
       accumulator_addsubsub(accumulator, prev_accumulator, pawn, captured_piece,
                             promoted_piece, from, to, to);
     } else {
@@ -370,13 +369,11 @@ void accumulator_make_move(accumulator_t *accumulator,
 
   else if (enpass) {
     uint8_t remove_square = to + ((side == white) ? -8 : 8);
-    uint8_t captured_piece = mailbox[remove_square];
     accumulator_addsubsub(accumulator, prev_accumulator, captured_piece,
                           moving_piece, moving_piece, remove_square, from, to);
   }
 
   else if (capture) {
-    uint8_t captured_piece = mailbox[to];
     accumulator_addsubsub(accumulator, prev_accumulator, captured_piece,
                           moving_piece, moving_piece, to, from, to);
   }
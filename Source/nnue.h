@@ -26,6 +26,7 @@ void init_accumulator(position_t *pos, accumulator_t *accumulator);
 int nnue_evaluate(position_t *pos, accumulator_t *accumulator);
 int nnue_eval_pos(position_t *pos, accumulator_t *accumulator);
 void accumulator_make_move(accumulator_t *accumulator, accumulator_t *prev_accumualator,
-                           uint8_t side, int move, uint8_t *mailbox);
+                           uint8_t side, int move, uint8_t moving_piece,
+                           uint8_t captured_piece);
 
 #endif
@@ -3,102 +3,155 @@
 #include "move.h"
 #include "movegen.h"
 #include "structs.h"
+#include "threads.h"
+#include "transposition.h"
 #include "uci.h"
 #include "utils.h"
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-static inline void perft_driver(position_t *pos, thread_t *thread, int depth) {
-  // recursion escape condition
-  if (depth == 0) {
-    // increment nodes count (count reached positions)
-    thread->nodes++;
-    return;
-  }
+extern int thread_count;
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+// perft hash, sized like the transposition table and only alive during a run
+static perft_entry_t *perft_table;
+static uint64_t perft_table_size;
 
+// root divide shared by the perft threads, each root move is taken exactly
+// once by whichever thread gets to it first
+static moves root_moves[1];
+static uint64_t root_nodes[280];
+static atomic_uint next_root_move;
+static int perft_depth;
+
+static inline perft_entry_t *perft_entry(uint64_t hash_key) {
+  return &perft_table[((uint128_t)hash_key * perft_table_size) >> 64];
+}
+
+static uint64_t perft_driver(position_t *pos, int depth) {
   // create move list instance
   moves move_list[1];
 
+  // bulk counting, the generator only produces legal moves
+  if (depth == 1) {
+    generate_moves(pos, move_list);
+    return move_list->count;
+  }
+
+  perft_entry_t *entry = NULL;
+  if (perft_table) {
+    entry = perft_entry(pos->hash_key);
+    uint64_t data = entry->data;
+    if ((entry->key ^ data) == pos->hash_key && (data & 0xFF) == (uint64_t)depth)
+      return data >> 8;
+  }
+
   // generate moves
   generate_moves(pos, move_list);
 
+  uint64_t nodes = 0;
+
   // loop over generated moves
   for (uint32_t move_count = 0; move_count < move_list->count; move_count++) {
-    // preserve board state
-    copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-               pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+    undo_t undo;
 
     // make move
-    if (!make_move(pos, move_list->entry[move_count].move, all_moves))
-      // skip to the next move
-      continue;
+    make_move(pos, move_list->entry[move_count].move, all_moves, &undo);
 
     // call perft driver recursively
-    perft_driver(pos, thread, depth - 1);
+    nodes += perft_driver(pos, depth - 1);
 
     // take back
-    restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                  pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+    unmake_move(pos, move_list->entry[move_count].move, &undo);
   }
+
+  if (entry) {
+    uint64_t data = nodes << 8 | depth;
+    entry->key = pos->hash_key ^ data;
+    entry->data = data;
+  }
+
+  return nodes;
 }
 
-// perft test
-void perft_test(position_t *pos, thread_t *searchinfo, int depth) {
-  printf("\n     Performance test\n\n");
+static void *perft_worker(void *thread_info) {
+  thread_t *thread = (thread_t *)thread_info;
+  position_t *pos = &thread->pos;
+  uint32_t index;
 
-  // create move list instance
-  moves move_list[1];
+  while ((index = atomic_fetch_add(&next_root_move, 1)) < root_moves->count) {
+    uint16_t move = root_moves->entry[index].move;
+    undo_t undo;
 
-  // generate moves
-  generate_moves(pos, move_list);
+    make_move(pos, move, all_moves, &undo);
+    root_nodes[index] = perft_depth > 1 ? perft_driver(pos, perft_depth - 1) : 1;
+    unmake_move(pos, move, &undo);
 
-  // init start time
-  long start = get_time_ms();
+    thread->nodes += root_nodes[index];
+  }
 
-  // loop over generated moves
-  for (uint32_t move_count = 0; move_count < move_list->count; move_count++) {
-    // preserve board state
-    copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-               pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+  return NULL;
+}
 
-    // make move
-    if (!make_move(pos, move_list->entry[move_count].move, all_moves))
-      // skip to the next move
-      continue;
+// count the leaf nodes to the given depth, the root moves are split over the
+// thread pool and their counts are kept for the divide
+uint64_t perft(position_t *pos, thread_t *threads, int depth) {
+  perft_table_size = tt.num_of_entries * sizeof(tt_entry_t) / sizeof(perft_entry_t);
+  perft_table = calloc(perft_table_size, sizeof(perft_entry_t));
+
+  generate_moves(pos, root_moves);
+  perft_depth = MAX(depth, 1);
+  atomic_store(&next_root_move, 0);
+
+  pthread_t pthreads[thread_count];
+  for (int i = 0; i < thread_count; ++i) {
+    threads[i].nodes = 0;
+    memcpy(&threads[i].pos, pos, sizeof(position_t));
+    pthread_create(&pthreads[i], NULL, &perft_worker, &threads[i]);
+  }
 
-    // cummulative nodes
-    long cummulative_nodes = searchinfo->nodes;
+  for (int i = 0; i < thread_count; ++i) {
+    pthread_join(pthreads[i], NULL);
+  }
 
-    // call perft driver recursively
-    perft_driver(pos, searchinfo, depth - 1);
+  free(perft_table);
+  perft_table = NULL;
 
-    // old nodes
-    long old_nodes = searchinfo->nodes - cummulative_nodes;
-    (void)old_nodes;
+  return total_nodes(threads, thread_count);
+}
 
-    // take back
-    restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                  pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
-
-    // print move
-    printf("     move: %s%s%c  nodes: %ld\n",
-           square_to_coordinates[get_move_source(
-               move_list->entry[move_count].move)],
-           square_to_coordinates[get_move_target(
-               move_list->entry[move_count].move)],
-           is_move_promotion(move_list->entry[move_count].move)
-               ? promoted_pieces[get_move_promoted(
-                     pos->side, move_list->entry[move_count].move)]
+// perft test
+void perft_test(position_t *pos, thread_t *threads, int depth) {
+  printf("\n     Performance test\n\n");
+
+  // init start time
+  uint64_t start = get_time_ms();
+
+  uint64_t nodes = perft(pos, threads, depth);
+
+  // print the divide in generation order
+  for (uint32_t move_count = 0; move_count < root_moves->count; move_count++) {
+    uint16_t move = root_moves->entry[move_count].move;
+    printf("     move: %s%s%c  nodes: %" PRIu64 "\n",
+           square_to_coordinates[get_move_source(move)],
+           square_to_coordinates[get_move_target(move)],
+           is_move_promotion(move)
+               ? promoted_pieces[get_move_promoted(pos->side, move)]
                : ' ',
-           old_nodes);
+           root_nodes[move_count]);
   }
 
   // print results
-  printf("\n    Depth: %d\n", depth);
-  uint64_t nps = (searchinfo->nodes / fmax(get_time_ms() - start, 1)) * 1000;
-  printf("    Nodes: %" PRIu64 "\n", searchinfo->nodes);
-  printf("     Time: %" PRIu64 "\n\n", get_time_ms() - start);
+  uint64_t time = get_time_ms() - start;
+  uint64_t nps = (nodes / fmax(time, 1)) * 1000;
+  printf("\n    Depth: %d\n", perft_depth);
+  printf("    Nodes: %" PRIu64 "\n", nodes);
+  printf("     Time: %" PRIu64 "\n\n", time);
   printf("      NPS: %" PRIu64 "\n\n", nps);
 }
@@ -2,6 +2,7 @@
 #define PERFT_H
 
 #include "structs.h"
+uint64_t perft(position_t *pos, thread_t *threads, int depth);
 void perft_test(position_t* pos, thread_t *thread, int depth);
 
 #endif
@@ -21,102 +21,40 @@
 #include "threads.h"
 #include "transposition.h"
 #include "uci.h"
+#include "utils.h"
 
 position_t pos;
 thread_t *threads;
 nnue_settings_t nnue_settings;
 limits_t limits;
-keys_t keys;
-uint32_t random_state;
+startup_t startup;
 
 extern const int default_hash_size;
 extern int thread_count;
 extern nnue_t nnue;
 
-// generate 32-bit pseudo legal numbers
-uint32_t get_random_U32_number(void) {
-  // get current state
-  uint32_t number = random_state;
-
-  // XOR shift algorithm
-  number ^= number << 13;
-  number ^= number >> 17;
-  number ^= number << 5;
-
-  // update random number state
-  random_state = number;
-
-  // return random number
-  return number;
-}
-
-// generate 64-bit pseudo legal numbers
-uint64_t get_random_uint64_number(void) {
-  // define 4 random numbers
-  uint64_t n1, n2, n3, n4;
-
-  // init random numbers slicing 16 bits from MS1B side
-  n1 = (uint64_t)(get_random_U32_number()) & 0xFFFF;
-  n2 = (uint64_t)(get_random_U32_number()) & 0xFFFF;
-  n3 = (uint64_t)(get_random_U32_number()) & 0xFFFF;
-  n4 = (uint64_t)(get_random_U32_number()) & 0xFFFF;
-
-  // return random number
-  return n1 | (n2 << 16) | (n3 << 32) | (n4 << 48);
-}
-
-// generate magic number candidate
-uint64_t generate_magic_number(void) {
-  return get_random_uint64_number() & get_random_uint64_number() &
-         get_random_uint64_number();
-}
-
-// init random hash keys (zobrist keys)
-static inline void init_random_keys(void) {
-  // update pseudo random number state
-  random_state = 1804289383;
-
-  // loop over piece codes
-  for (int piece = P; piece <= k; piece++) {
-    // loop over board squares
-    for (int square = 0; square < 64; square++)
-      // init random piece keys
-      keys.piece_keys[piece][square] = get_random_uint64_number();
-  }
-
-  // loop over board squares
-  for (int square = 0; square < 64; square++)
-    // init random enpassant keys
-    keys.enpassant_keys[square] = get_random_uint64_number();
-
-  // loop over castling keys
-  for (int index = 0; index < 16; index++)
-    // init castling keys
-    keys.castle_keys[index] = get_random_uint64_number();
-
-  // init random side key
-  keys.side_key = get_random_uint64_number();
-}
-
-// init all variables
+// init all variables, attack tables and hash keys are generated at build time
 void init_all(void) {
-  // init leaper pieces attacks
-  init_leapers_attacks();
-
-  // init slider pieces attacks
-  init_sliders_attacks();
+  uint64_t start = get_time_us();
 
-  // init random keys for hashing purposes
-  init_random_keys();
+#ifndef NDEBUG
+  uint64_t lookups;
+  assert(!verify_sliders_attacks(&lookups));
+#endif
 
   init_reductions();
 
   init_spsa_table();
+  startup.search = get_time_us() - start;
 
   // init hash table with default size
+  start = get_time_us();
   init_hash_table(default_hash_size);
+  startup.hash = get_time_us() - start;
 
+  start = get_time_us();
   nnue_init("huginn.nnue");
+  startup.nnue = get_time_us() - start;
 }
 
 /**********************************\
@@ -128,11 +66,12 @@ void init_all(void) {
 \**********************************/
 
 int main(int argc, char *argv[]) {
+  startup.start = get_time_us();
   threads = init_threads(thread_count);
+  startup.threads = get_time_us() - startup.start;
   pos.enpassant = no_sq;
   limits.movestogo = 30;
   limits.time = -1;
-  random_state = 1804289383;
   tt.hash_entry = NULL;
   tt.num_of_entries = 0;
   nnue_settings.nnue_file = calloc(21, 1);
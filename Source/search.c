@@ -6,6 +6,7 @@
 #include "history.h"
 #include "move.h"
 #include "movegen.h"
+#include "movepicker.h"
 #include "nnue.h"
 #include "pyrrhic/tbprobe.h"
 #include "see.h"
@@ -18,6 +19,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -27,8 +29,13 @@
 extern volatile uint8_t ABORT_SIGNAL;
 
 extern int thread_count;
+extern uint8_t deterministic;
+extern int multi_pv;
 
-extern keys_t keys;
+extern const keys_t keys;
+extern key_stack_t game_history;
+extern const uint64_t cuckoo_keys[CUCKOO_SIZE];
+extern const uint16_t cuckoo_moves[CUCKOO_SIZE];
 
 int LMP_BASE = 3;
 int LMP_MULTIPLIER = 1;
@@ -90,123 +97,130 @@ void init_reductions(void) {
   }
 }
 
-uint8_t check_time(thread_t *thread) {
-  // if time is up break here
-  if (thread->index == 0 &&
-      ((limits.timeset && get_time_ms() > limits.hard_limit) ||
-       (limits.nodes_set && thread->nodes >= limits.node_limit))) {
-    // tell engine to stop calculating
-    thread->stopped = 1;
-    return 1;
-  }
-  return 0;
-}
+// Synchronizes the threads at iteration boundaries in deterministic mode
+barrier_t iteration_barrier;
+uint64_t synchronized_nodes;
+thread_t *search_threads;
 
-// score moves
-static inline void score_move(position_t *pos, thread_t *thread,
-                              searchstack_t *ss, move_t *move_entry,
-                              uint16_t hash_move) {
-  uint16_t move = move_entry->move;
-  uint8_t piece = get_move_promoted(pos->side, move);
+// Runs once per iteration while every thread waits at the barrier. The hash
+// entries along each completed principal variation are copied into the other
+// partitions, so every thread starts its next iteration from the best lines
+// found by all of them
+static void synchronize_threads(void) {
+  synchronized_nodes = total_nodes(search_threads, thread_count);
 
-  if (move == hash_move) {
-    move_entry->score = 2000000000;
-    return;
-  }
-
-  if (piece) {
-    switch (piece) {
-    case q:
-    case Q:
-      move_entry->score = 1400000001;
-      break;
-    case n:
-    case N:
-      move_entry->score = 1400000000;
-      break;
-    default:
-      move_entry->score = -1000000;
-      break;
+  for (int i = 0; i < thread_count; ++i) {
+    thread_t *thread = &search_threads[i];
+    // an interrupted iteration leaves an unfinished principal variation
+    if (thread->completed_depth != thread->depth) {
+      continue;
     }
-    if (get_move_capture(move) && SEE(pos, move, -MO_SEE_THRESHOLD)) {
-      return;
-    } else {
-      move_entry->score = -1000000;
-      return;
+    position_t pos = thread->pos;
+    undo_t undo;
+    for (int ply = 0; ply < thread->pv.pv_length[0]; ++ply) {
+      share_hash_entry(pos.hash_key, thread->index);
+      make_move(&pos, thread->pv.pv_table[0][ply], all_moves, &undo);
     }
   }
+}
 
-  move_entry->score = 0;
-
-  // score capture move
-  if (get_move_capture(move)) {
-    // init target piece
-    int target_piece = P;
+// The hard time limit is enforced by a timer thread, so the search itself
+// never reads the clock per node
+pthread_t timer;
+atomic_bool timer_running;
 
-    uint8_t bb_piece = pos->mailbox[get_move_target(move)];
-    // if there's a piece on the target square
-    if (bb_piece != NO_PIECE &&
-        get_bit(pos->bitboards[bb_piece], get_move_target(move))) {
-      target_piece = bb_piece;
+static void *timer_thread(void *thread_info) {
+  thread_t *threads = (thread_t *)thread_info;
+  while (atomic_load(&timer_running)) {
+    if (!limits.ponder && get_time_ms() > limits.hard_limit) {
+      stop_threads(threads, thread_count);
+      break;
     }
-
-    // score move by MVV LVA lookup [source piece][target piece]
-    move_entry->score +=
-        mvv[target_piece > 5 ? target_piece - 6 : target_piece];
-    move_entry->score +=
-        thread
-            ->capture_history[pos->mailbox[get_move_source(move)]][target_piece]
-                             [get_move_source(move)][get_move_target(move)];
-    move_entry->score +=
-        SEE(pos, move, -MO_SEE_THRESHOLD) ? 1000000000 : -1000000;
-    return;
+    sleep_ms(1);
   }
+  return NULL;
+}
 
-  // score quiet move
-  else {
-    // score 1st killer move
-    if (thread->killer_moves[pos->ply] == move) {
-      move_entry->score = 900000000;
-    }
-
-    // score history move
-    else {
-      move_entry->score =
-          thread->quiet_history[pos->mailbox[get_move_source(move)]]
-                               [get_move_source(move)][get_move_target(move)] +
-          get_conthist_score(thread, ss - 1, move) +
-          get_conthist_score(thread, ss - 2, move) +
-          get_conthist_score(thread, ss - 4, move);
+uint8_t check_time(thread_t *thread) {
+  // In deterministic mode every thread only obeys its own node budget so no
+  // thread ever depends on the timing of another one
+  if (deterministic && limits.nodes_set) {
+    if (thread->nodes >= limits.thread_node_limit) {
+      thread->stopped = 1;
+      return 1;
     }
+    return 0;
+  }
 
-    return;
+  // if the node budget is used up break here
+  if (thread->index == 0 && limits.nodes_set &&
+      thread->nodes >= limits.node_limit) {
+    // tell engine to stop calculating
+    stop_threads(thread, thread_count);
+    return 1;
   }
 
-  move_entry->score = 0;
-  return;
+  // stopped by the timer thread
+  return limits.timeset && thread->stopped;
 }
 
-// sort moves in descending order
-static inline void sort_moves(moves *move_list) {
-  for (uint32_t i = 1; i < move_list->count; i++) {
-    move_t key = move_list->entry[i];
-    int j = i - 1;
+// the move has to be legal in the root position
+static inline root_move_t *find_root_move(thread_t *thread, uint16_t move) {
+  root_move_t *root_move = thread->root_moves;
+  while (root_move->move != move)
+    root_move++;
+  return root_move;
+}
 
-    // Sort in descending order by score
-    while (j >= 0 && move_list->entry[j].score < key.score) {
-      move_list->entry[j + 1] = move_list->entry[j];
+// moves of the MultiPV lines already searched in this iteration
+static inline uint8_t is_excluded_root_move(thread_t *thread, uint16_t move) {
+  for (uint32_t i = 0; i < thread->pv_index; ++i) {
+    if (thread->root_moves[i].move == move) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// order the root moves in [begin, end) by their scores, the stable sort keeps
+// moves with equal scores in their previous order
+static inline void sort_root_moves(root_move_t *root_moves, uint32_t begin,
+                                   uint32_t end) {
+  for (uint32_t i = begin + 1; i < end; ++i) {
+    root_move_t root_move = root_moves[i];
+    uint32_t j = i;
+    while (j > begin && root_moves[j - 1].score < root_move.score) {
+      root_moves[j] = root_moves[j - 1];
       j--;
     }
-    move_list->entry[j + 1] = key;
+    root_moves[j] = root_move;
+  }
+}
+
+static inline void init_root_moves(thread_t *thread, position_t *pos) {
+  moves move_list[1];
+  generate_moves(pos, move_list);
+  for (uint32_t i = 0; i < move_list->count; ++i) {
+    thread->root_moves[i].move = move_list->entry[i].move;
+    thread->root_moves[i].nodes = 0;
+    thread->root_moves[i].score = -INF;
+    thread->root_moves[i].previous_score = -INF;
+    thread->root_moves[i].pv_length = 0;
   }
+  thread->root_move_count = move_list->count;
 }
 
-// position repetition detection
-static inline int is_repetition(position_t *pos) {
-  // loop over repetition indices range
-  for (uint32_t index = 0; index < pos->repetition_index; index++)
+// position repetition detection, only positions with the same side to move
+// since the last irreversible move or null move can repeat the current one
+static inline int is_repetition(position_t *pos, thread_t *thread) {
+  key_stack_t *history = &thread->key_history;
+  uint32_t max_distance =
+      MIN(MIN(pos->reversible_plies, pos->plies_from_null), history->count);
+
+  // loop over every second position back from the previous one
+  for (uint32_t distance = 2; distance <= max_distance; distance += 2)
     // if we found the hash key same with a current
-    if (pos->repetition_table[index] == pos->hash_key)
+    if (history->keys[history->count - distance] == pos->hash_key)
       // we found a repetition
       return 1;
 
@@ -214,6 +228,48 @@ static inline int is_repetition(position_t *pos) {
   return 0;
 }
 
+// Detects if the side to move can repeat an earlier position of the search
+// with a single reversible move. The key difference of the two positions has
+// to be a piece move from the cuckoo tables with an empty path
+static inline int has_upcoming_repetition(position_t *pos, thread_t *thread) {
+  key_stack_t *history = &thread->key_history;
+  // a null move only flips the side key, it would cancel out of other like a
+  // move that went back and forth
+  uint32_t max_distance =
+      MIN(MIN(pos->reversible_plies, pos->plies_from_null), history->count);
+  if (max_distance < 3)
+    return 0;
+
+  // keys of the moves in between have to cancel out, so the other side
+  // only shuffled back and forth
+  uint64_t other = pos->hash_key ^ history->keys[history->count - 1] ^
+                   keys.side_key;
+
+  for (uint32_t distance = 3; distance <= max_distance; distance += 2) {
+    other ^= history->keys[history->count - distance + 1] ^
+             history->keys[history->count - distance] ^ keys.side_key;
+    if (other)
+      continue;
+
+    uint64_t move_key = pos->hash_key ^ history->keys[history->count - distance];
+    uint32_t slot = CUCKOO_H1(move_key);
+    if (cuckoo_keys[slot] != move_key)
+      slot = CUCKOO_H2(move_key);
+    if (cuckoo_keys[slot] != move_key)
+      continue;
+
+    // only repeat positions inside the search, game history repetitions
+    // need a real second occurrence
+    uint16_t move = cuckoo_moves[slot];
+    if (!(between_masks[get_move_source(move)][get_move_target(move)] &
+          pos->occupancies[both]) &&
+        pos->ply > distance)
+      return 1;
+  }
+
+  return 0;
+}
+
 static inline uint8_t is_material_draw(position_t *pos) {
   uint8_t piece_count = __builtin_popcountll(pos->occupancies[both]);
 
@@ -257,7 +313,6 @@ static inline int quiescence(position_t *pos, thread_t *thread,
                              searchstack_t *ss, int alpha, int beta) {
   // Check on time
   if (check_time(thread)) {
-    stop_threads(thread, thread_count);
     return 0;
   }
 
@@ -284,7 +339,7 @@ static inline int quiescence(position_t *pos, thread_t *thread,
 
   if (pos->ply &&
       (tt_hit =
-           read_hash_entry(pos, &best_move, &tt_score, &tt_depth, &tt_flag, &tt_pv)) &&
+           read_hash_entry(pos, thread->index, &best_move, &tt_score, &tt_depth, &tt_flag, &tt_pv)) &&
       pv_node == 0) {
     if ((tt_flag == HASH_FLAG_EXACT) ||
         ((tt_flag == HASH_FLAG_UPPER_BOUND) && (tt_score <= alpha)) ||
@@ -312,64 +367,48 @@ static inline int quiescence(position_t *pos, thread_t *thread,
     alpha = score;
   }
 
-  // create move list instance
-  moves move_list[1];
+  // create move picker instance
+  movepicker_t picker;
   moves capture_list[1];
   capture_list->count = 0;
 
-  // generate moves
-  generate_captures(pos, move_list);
+  init_picker(&picker, pos, thread, ss, best_move, 1, 0);
 
-  for (uint32_t count = 0; count < move_list->count; count++) {
-    score_move(pos, thread, ss, &move_list->entry[count], best_move);
-  }
+  // loop over moves returned by the picker
+  uint16_t move;
+  while ((move = next_move(&picker, pos))) {
 
-  sort_moves(move_list);
-
-  // loop over moves within a movelist
-  for (uint32_t count = 0; count < move_list->count; count++) {
-
-    if (!SEE(pos, move_list->entry[count].move, -QS_SEE_THRESHOLD))
+    if (!SEE(pos, move, -QS_SEE_THRESHOLD))
       continue;
 
-    // preserve board state
-    copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-               pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+    undo_t undo;
+    uint8_t piece = pos->mailbox[get_move_source(move)];
 
     // increment ply
     pos->ply++;
 
-    // increment repetition index & store hash key
-    pos->repetition_index++;
-    pos->repetition_table[pos->repetition_index] = pos->hash_key;
-
-    // make sure to make only legal moves
-    if (make_move(pos, move_list->entry[count].move, only_captures) == 0) {
-      // decrement ply
-      pos->ply--;
+    // store hash key for repetition detection
+    thread->key_history.keys[thread->key_history.count++] = pos->hash_key;
 
-      // decrement repetition index
-      pos->repetition_index--;
-
-      // skip to next move
-      continue;
-    }
+    // make move, the picker only returns legal moves
+    make_move(pos, move, all_moves, &undo);
 
     accumulator_make_move(&thread->accumulator[pos->ply],
                           &thread->accumulator[pos->ply - 1], pos->side,
-                          move_list->entry[count].move, mailbox_copy);
+                          move, piece, undo.captured_piece);
 
-    ss->move = move_list->entry[count].move;
-    ss->piece = mailbox_copy[get_move_source(move_list->entry[count].move)];
+    ss->move = move;
+    ss->continuation_history =
+        thread->continuation_history[piece][get_move_target(move)];
 
     thread->nodes++;
 
-    if (!is_move_promotion(move_list->entry[count].move) ||
-        !get_move_capture(move_list->entry[count].move)) {
-      add_move(capture_list, move_list->entry[count].move);
+    if (!is_move_promotion(move) ||
+        !get_move_capture(move)) {
+      add_move(capture_list, move);
     }
 
-    prefetch_hash_entry(pos->hash_key);
+    prefetch_hash_entry(pos->hash_key, thread->index);
 
     // score current move
     score = -quiescence(pos, thread, ss, -beta, -alpha);
@@ -377,12 +416,11 @@ static inline int quiescence(position_t *pos, thread_t *thread,
     // decrement ply
     pos->ply--;
 
-    // decrement repetition index
-    pos->repetition_index--;
+    // drop hash key
+    thread->key_history.count--;
 
     // take move back
-    restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                  pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+    unmake_move(pos, move, &undo);
 
     // return 0 if time is up
     if (thread->stopped == 1) {
@@ -391,7 +429,7 @@ static inline int quiescence(position_t *pos, thread_t *thread,
 
     if (score > best_score) {
       best_score = score;
-      best_move = move_list->entry[count].move;
+      best_move = move;
       // found a better move
       if (score > alpha) {
         alpha = score;
@@ -411,14 +449,41 @@ static inline int quiescence(position_t *pos, thread_t *thread,
     hash_flag = HASH_FLAG_UPPER_BOUND;
   }
 
-  write_hash_entry(pos, best_score, 0, best_move, hash_flag, pv_node);
+  write_hash_entry(pos, thread->index, best_score, 0, best_move, hash_flag, pv_node);
 
   return best_score;
 }
 
-// negamax alpha beta search
-static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
-                          int alpha, int beta, int depth, uint8_t cutnode, uint8_t pv_node) {
+static int negamax_root(position_t *pos, thread_t *thread, searchstack_t *ss,
+                        int alpha, int beta, int depth, uint8_t cutnode);
+static int negamax_pv(position_t *pos, thread_t *thread, searchstack_t *ss,
+                      int alpha, int beta, int depth, uint8_t cutnode);
+static int negamax_non_pv(position_t *pos, thread_t *thread, searchstack_t *ss,
+                          int alpha, int beta, int depth, uint8_t cutnode);
+
+// call the search specialized for a node type, the node type is a constant in
+// every caller so the dispatch folds away
+static FORCE_INLINE int negamax(position_t *pos, thread_t *thread,
+                                searchstack_t *ss, int alpha, int beta,
+                                int depth, uint8_t cutnode,
+                                const uint8_t node_type) {
+  if (node_type == ROOT_NODE)
+    return negamax_root(pos, thread, ss, alpha, beta, depth, cutnode);
+  if (node_type == PV_NODE)
+    return negamax_pv(pos, thread, ss, alpha, beta, depth, cutnode);
+  return negamax_non_pv(pos, thread, ss, alpha, beta, depth, cutnode);
+}
+
+// negamax alpha beta search. Each node type gets its own copy, so the root
+// and PV bookkeeping and the non PV pruning conditions are resolved at
+// compile time
+static FORCE_INLINE int negamax_node(position_t *pos, thread_t *thread,
+                                     searchstack_t *ss, int alpha, int beta,
+                                     int depth, uint8_t cutnode,
+                                     const uint8_t node_type) {
+  const uint8_t pv_node = node_type != NON_PV;
+  const uint8_t root_node = node_type == ROOT_NODE;
+
   // init PV length
   thread->pv.pv_length[pos->ply] = pos->ply;
 
@@ -434,15 +499,13 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
   uint8_t tt_pv = 0;
   uint8_t tt_was_pv = pv_node;
 
-  uint8_t root_node = pos->ply == 0;
-
   if (depth == 0 && pos->ply > pos->seldepth) {
     pos->seldepth = pos->ply;
   }
 
   if (!root_node) {
     // if position repetition occurs
-    if (is_repetition(pos) || pos->fifty >= 100 || is_material_draw(pos)) {
+    if (is_repetition(pos, thread) || pos->fifty >= 100 || is_material_draw(pos)) {
       // return draw score
       return 1 - (thread->nodes & 2);
     }
@@ -459,14 +522,17 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
     beta = MIN(beta, MATE_VALUE - (int)pos->ply - 1);
     if (alpha >= beta)
       return alpha;
+
+    // a draw by repetition is one move away, so the score is at least a draw
+    if (alpha < 0 && has_upcoming_repetition(pos, thread)) {
+      alpha = 1 - (thread->nodes & 2);
+      if (alpha >= beta)
+        return alpha;
+    }
   }
 
   // is king in check
-  int in_check = is_square_attacked(pos,
-                                    (pos->side == white)
-                                        ? __builtin_ctzll(pos->bitboards[K])
-                                        : __builtin_ctzll(pos->bitboards[k]),
-                                    pos->side ^ 1);
+  int in_check = pos->check_info.checkers != 0ULL;
 
   // recursion escape condition
   if (!in_check && depth <= 0) {
@@ -478,7 +544,7 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
   // and current node is not a PV node
   if (!ss->excluded_move &&
       (tt_hit =
-           read_hash_entry(pos, &tt_move, &tt_score, &tt_depth, &tt_flag, &tt_pv)) &&
+           read_hash_entry(pos, thread->index, &tt_move, &tt_score, &tt_depth, &tt_flag, &tt_pv)) &&
       pv_node == 0 && !root_node) {
     if (tt_depth >= depth) {
       if ((tt_flag == HASH_FLAG_EXACT) ||
@@ -512,7 +578,6 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
 
   // Check on time
   if (check_time(thread)) {
-    stop_threads(thread, thread_count);
     return 0;
   }
 
@@ -539,35 +604,22 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       int R = MIN((ss->static_eval - beta) / NMP_RED_DIVISER, NMP_RED_MIN) +
               depth / NMP_DIVISER + NMP_BASE_REDUCTION;
       R = MIN(R, depth);
-      // preserve board state
-      copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                 pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+      undo_t undo;
       thread->accumulator[pos->ply + 1] = thread->accumulator[pos->ply];
 
       // increment ply
       pos->ply++;
 
-      // increment repetition index & store hash key
-      pos->repetition_index++;
-      pos->repetition_table[pos->repetition_index] = pos->hash_key;
+      // store hash key for repetition detection
+      thread->key_history.keys[thread->key_history.count++] = pos->hash_key;
 
-      // hash enpassant if available
-      if (pos->enpassant != no_sq)
-        pos->hash_key ^= keys.enpassant_keys[pos->enpassant];
+      // give the opponent an extra move to make
+      make_null_move(pos, &undo);
 
-      // reset enpassant capture square
-      pos->enpassant = no_sq;
-
-      // switch the side, literally giving opponent an extra move to make
-      pos->side ^= 1;
-
-      // hash the side
-      pos->hash_key ^= keys.side_key;
-
-      prefetch_hash_entry(pos->hash_key);
+      prefetch_hash_entry(pos->hash_key, thread->index);
 
       ss->move = 0;
-      ss->piece = 0;
+      ss->continuation_history = thread->continuation_history[0][0];
       (ss + 1)->null_move = 1;
 
       /* search moves with reduced depth to find beta cutoffs
@@ -580,12 +632,11 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       // decrement ply
       pos->ply--;
 
-      // decrement repetition index
-      pos->repetition_index--;
+      // drop hash key
+      thread->key_history.count--;
 
       // restore board state
-      restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                    pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+      unmake_null_move(pos, &undo);
 
       // return 0 if time is up
       if (thread->stopped == 1) {
@@ -607,33 +658,25 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
     }
   }
 
-  // create move list instance
-  moves move_list[1];
+  // create move picker instance
+  movepicker_t picker;
   moves quiet_list[1];
   moves capture_list[1];
   quiet_list->count = 0;
   capture_list->count = 0;
 
-  // generate moves
-  generate_moves(pos, move_list);
+  init_picker(&picker, pos, thread, ss, tt_move, 0, in_check);
 
   int best_score = -INF;
   current_score = -INF;
 
   int best_move = 0;
-  for (uint32_t count = 0; count < move_list->count; count++) {
-    score_move(pos, thread, ss, &move_list->entry[count], tt_move);
-  }
-
-  sort_moves(move_list);
-
-  uint8_t skip_quiets = 0;
 
   const int original_alpha = alpha;
 
-  // loop over moves within a movelist
-  for (uint32_t count = 0; count < move_list->count; count++) {
-    int move = move_list->entry[count].move;
+  // loop over moves returned by the picker
+  uint16_t move;
+  while ((move = next_move(&picker, pos))) {
     uint8_t quiet =
         (get_move_capture(move) == 0 && is_move_promotion(move) == 0);
 
@@ -641,7 +684,7 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       continue;
     }
 
-    if (skip_quiets && quiet) {
+    if (root_node && thread->pv_index && is_excluded_root_move(thread, move)) {
       continue;
     }
 
@@ -650,17 +693,14 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
             ? thread
                   ->quiet_history[pos->mailbox[get_move_source(move)]]
                                  [get_move_source(move)][get_move_target(move)]
-            : thread->capture_history[pos->mailbox[get_move_source(move)]]
-                                     [pos->mailbox[get_move_target(move)]]
-                                     [get_move_source(move)]
-                                     [get_move_target(move)];
+            : *capture_history_entry(thread, pos, move);
 
     // Late Move Pruning
     if (!pv_node && !in_check && quiet &&
         legal_moves >
             LMP_BASE + LMP_MULTIPLIER * depth * depth / (2 - improving) &&
         !only_pawns(pos)) {
-      skip_quiets = 1;
+      picker.skip_quiets = 1;
     }
 
     int r = lmr[quiet][MIN(63, depth)][MIN(63, legal_moves)];
@@ -670,7 +710,7 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
     if (!root_node && current_score > -MATE_SCORE && lmr_depth <= FP_DEPTH &&
         !in_check && quiet &&
         ss->static_eval + lmr_depth * FP_MULTIPLIER + FP_ADDITION <= alpha) {
-      skip_quiets = 1;
+      picker.skip_quiets = 1;
       continue;
     }
 
@@ -692,16 +732,6 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       const int s_beta = tt_score - depth;
       const int s_depth = (depth - 1) / 2;
 
-      copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                 pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
-
-      if (make_move(pos, move, all_moves) == 0) {
-        continue;
-      }
-
-      restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                    pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
-
       ss->excluded_move = move;
 
       const int16_t s_score =
@@ -737,35 +767,26 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       }
     }
 
-    // preserve board state
-    copy_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-               pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+    undo_t undo;
+    uint8_t piece = pos->mailbox[get_move_source(move)];
+    uint64_t nodes_before = thread->nodes;
 
     // increment ply
     pos->ply++;
 
-    // increment repetition index & store hash key
-    pos->repetition_index++;
-    pos->repetition_table[pos->repetition_index] = pos->hash_key;
-
-    // make sure to make only legal moves
-    if (make_move(pos, move, all_moves) == 0) {
-      // decrement ply
-      pos->ply--;
-
-      // decrement repetition index
-      pos->repetition_index--;
+    // store hash key for repetition detection
+    thread->key_history.keys[thread->key_history.count++] = pos->hash_key;
 
-      // skip to next move
-      continue;
-    }
+    // make move, the picker only returns legal moves
+    make_move(pos, move, all_moves, &undo);
 
     accumulator_make_move(&thread->accumulator[pos->ply],
                           &thread->accumulator[pos->ply - 1], pos->side,
-                          move_list->entry[count].move, mailbox_copy);
+                          move, piece, undo.captured_piece);
 
     ss->move = move;
-    ss->piece = mailbox_copy[get_move_source(move)];
+    ss->continuation_history =
+        thread->continuation_history[piece][get_move_target(move)];
 
     // increment nodes count
     thread->nodes++;
@@ -780,7 +801,7 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       add_move(capture_list, move);
     }
 
-    prefetch_hash_entry(pos->hash_key);
+    prefetch_hash_entry(pos->hash_key, thread->index);
 
     uint8_t needs_full_search = 0;
 
@@ -821,12 +842,11 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
     // decrement ply
     pos->ply--;
 
-    // decrement repetition index
-    pos->repetition_index--;
+    // drop hash key
+    thread->key_history.count--;
 
     // take move back
-    restore_board(pos->bitboards, pos->occupancies, pos->side, pos->enpassant,
-                  pos->castle, pos->fifty, pos->hash_key, pos->mailbox);
+    unmake_move(pos, move, &undo);
 
     // return INF so we can deal with timeout in case we are doing
     // re-search
@@ -834,6 +854,13 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       return 0;
     }
 
+    if (root_node) {
+      root_move_t *root_move = find_root_move(thread, move);
+      root_move->nodes += thread->nodes - nodes_before;
+      root_move->score =
+          legal_moves == 1 || current_score > alpha ? current_score : -INF;
+    }
+
     // found a better move
     if (current_score > best_score) {
       best_score = current_score;
@@ -886,7 +913,9 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       return 0;
   }
 
-  if (!ss->excluded_move) {
+  // later MultiPV lines leave out the best moves, their root result is not
+  // the score of the position
+  if (!ss->excluded_move && !(root_node && thread->pv_index)) {
     uint8_t hash_flag = HASH_FLAG_EXACT;
     if (alpha >= beta) {
       hash_flag = HASH_FLAG_LOWER_BOUND;
@@ -894,21 +923,38 @@ static inline int negamax(position_t *pos, thread_t *thread, searchstack_t *ss,
       hash_flag = HASH_FLAG_UPPER_BOUND;
     }
     // store hash entry with the score equal to alpha
-    write_hash_entry(pos, best_score, depth, best_move, hash_flag, pv_node);
+    write_hash_entry(pos, thread->index, best_score, depth, best_move, hash_flag, pv_node);
   }
 
   // node (position) fails low
   return best_score;
 }
 
-static void print_thinking(thread_t *thread, int score, int current_depth) {
+// instantiate the search for one node type
+#define DEFINE_NEGAMAX(name, node_type)                                        \
+  static int name(position_t *pos, thread_t *thread, searchstack_t *ss,        \
+                  int alpha, int beta, int depth, uint8_t cutnode) {           \
+    return negamax_node(pos, thread, ss, alpha, beta, depth, cutnode,          \
+                        node_type);                                            \
+  }
+
+DEFINE_NEGAMAX(negamax_root, ROOT_NODE)
+DEFINE_NEGAMAX(negamax_pv, PV_NODE)
+DEFINE_NEGAMAX(negamax_non_pv, NON_PV)
+
+static void print_thinking(thread_t *thread, int score, int current_depth,
+                           uint32_t line) {
 
-  uint64_t nodes = total_nodes(thread, thread_count);
+  uint64_t nodes =
+      deterministic ? synchronized_nodes : total_nodes(thread, thread_count);
   uint64_t time = get_time_ms() - thread->starttime;
   uint64_t nps = (nodes / fmax(time, 1)) * 1000;
 
-  printf("info depth %d seldepth %d score ", current_depth,
-         thread->pos.seldepth);
+  printf("info depth %d seldepth %d ", current_depth, thread->pos.seldepth);
+  if (multi_pv > 1) {
+    printf("multipv %d ", line + 1);
+  }
+  printf("score ");
 
   if (score > -MATE_VALUE && score < -MATE_SCORE) {
     printf("mate %d ", -(score + MATE_VALUE) / 2 - 1);
@@ -924,16 +970,35 @@ static void print_thinking(thread_t *thread, int score, int current_depth) {
   printf("pv ");
 
   // loop over the moves within a PV line
-  for (int count = 0; count < thread->pv.pv_length[0]; count++) {
-    // print PV move
-    print_move(thread->pv.pv_table[0][count]);
-    printf(" ");
+  if (line) {
+    root_move_t *root_move = &thread->root_moves[line];
+    for (int count = 0; count < root_move->pv_length; count++) {
+      print_move(root_move->pv[count]);
+      printf(" ");
+    }
+  } else {
+    for (int count = 0; count < thread->pv.pv_length[0]; count++) {
+      // print PV move
+      print_move(thread->pv.pv_table[0][count]);
+      printf(" ");
+    }
   }
 
   // print new line
   printf("\n");
 }
 
+// copy the PV and score of the first MultiPV line back into the main PV, which
+// the later lines overwrite
+static inline void restore_first_line(thread_t *thread) {
+  root_move_t *root_move = &thread->root_moves[0];
+  thread->score = root_move->score;
+  thread->pv.pv_length[0] = root_move->pv_length;
+  for (int i = 0; i < root_move->pv_length; ++i) {
+    thread->pv.pv_table[0][i] = root_move->pv[i];
+  }
+}
+
 void *iterative_deepening(void *thread_void) {
   thread_t *thread = (thread_t *)thread_void;
   position_t *pos = &thread->pos;
@@ -943,8 +1008,13 @@ void *iterative_deepening(void *thread_void) {
   uint8_t best_move_stability = 0;
   uint8_t eval_stability = 0;
 
+  // In deterministic mode the odd helpers stay one ply ahead of the others,
+  // so extra threads add deeper searches instead of repeating the same one
+  uint8_t start_depth = 1 + (deterministic && (thread->index & 1));
+
   // iterative deepening
-  for (thread->depth = 1; thread->depth <= limits.depth; thread->depth++) {
+  for (thread->depth = start_depth; thread->depth <= limits.depth;
+       thread->depth++) {
     // if time is up
     if (thread->stopped == 1) {
       // stop calculating and return best move so far
@@ -961,60 +1031,123 @@ void *iterative_deepening(void *thread_void) {
       ss[i].static_eval = NO_SCORE;
       ss[i].history_score = 0;
       ss[i].move = 0;
-      ss[i].piece = 0;
+      ss[i].continuation_history = thread->continuation_history[0][0];
       ss[i].null_move = 0;
     }
 
     pos->seldepth = 0;
 
-    int window = ASP_WINDOW;
-
-    int fail_high_count = 0;
+    for (uint32_t i = 0; i < thread->root_move_count; ++i) {
+      thread->root_moves[i].previous_score = thread->root_moves[i].score;
+    }
 
-    while (true) {
+    uint32_t pv_lines = MAX(1, MIN((uint32_t)multi_pv, thread->root_move_count));
 
-      if (check_time(thread)) {
-        stop_threads(thread, thread_count);
-        break;
+    for (thread->pv_index = 0; thread->pv_index < pv_lines;
+         ++thread->pv_index) {
+      // every further line starts its aspiration window from its own score
+      if (thread->pv_index) {
+        alpha = -INF;
+        beta = INF;
+        thread->score = thread->root_moves[thread->pv_index].previous_score;
       }
 
-      if (thread->stopped) {
-        break;
-      }
+      int window = ASP_WINDOW;
 
-      if (thread->depth >= ASP_DEPTH) {
-        alpha = MAX(-INF, thread->score - window);
-        beta = MIN(INF, thread->score + window);
-      }
+      int fail_high_count = 0;
 
-      // find best move within a given position
-      thread->score = negamax(pos, thread, ss + 4, alpha, beta,
-                              thread->depth - fail_high_count, 0, PV_NODE);
+      while (true) {
 
-      // We hit an apspiration window cut-off before time ran out and we jumped
-      // to another depth with wider search which we didnt finish
-      if (thread->stopped) {
-        return NULL;
-      }
+        if (check_time(thread)) {
+          break;
+        }
 
-      if (thread->score <= alpha) {
-        beta = (alpha + beta) / 2;
+        if (thread->stopped) {
+          break;
+        }
 
-        alpha = MAX(-INF, alpha - window);
-        fail_high_count = 0;
-      }
+        if (thread->depth >= ASP_DEPTH && thread->score > -INF) {
+          alpha = MAX(-INF, thread->score - window);
+          beta = MIN(INF, thread->score + window);
+        }
 
-      else if (thread->score >= beta) {
-        beta = MIN(INF, beta + window);
+        // find best move within a given position
+        thread->score = negamax(pos, thread, ss + 4, alpha, beta,
+                                thread->depth - fail_high_count, 0, ROOT_NODE);
 
-        if (alpha < 2000 && fail_high_count < 2) {
-          ++fail_high_count;
+        // We hit an apspiration window cut-off before time ran out and we
+        // jumped to another depth with wider search which we didnt finish
+        if (thread->stopped) {
+          break;
+        }
+
+        if (thread->score <= alpha) {
+          beta = (alpha + beta) / 2;
+
+          alpha = MAX(-INF, alpha - window);
+          fail_high_count = 0;
+        }
+
+        else if (thread->score >= beta) {
+          beta = MIN(INF, beta + window);
+
+          if (alpha < 2000 && fail_high_count < 2) {
+            ++fail_high_count;
+          }
+        } else {
+          break;
+        }
+
+        window *= ASP_MULTIPLIER;
+      }
+
+      if (thread->stopped) {
+        // later lines leave out the best moves, so an interrupted one must
+        // not replace the first line. The first line of this depth is
+        // complete and is reported as the result
+        if (thread->pv_index) {
+          restore_first_line(thread);
+          if (thread->index == 0) {
+            print_thinking(thread, thread->score, thread->depth, 0);
+          }
         }
-      } else {
         break;
       }
 
-      window *= ASP_MULTIPLIER;
+      if (pv_lines > 1) {
+        sort_root_moves(thread->root_moves, thread->pv_index,
+                        thread->root_move_count);
+        root_move_t *root_move = &thread->root_moves[thread->pv_index];
+        root_move->pv_length = thread->pv.pv_length[0];
+        for (int i = 0; i < thread->pv.pv_length[0]; ++i) {
+          root_move->pv[i] = thread->pv.pv_table[0][i];
+        }
+        // a later line can score above an earlier one, keep the finished
+        // lines in rank order
+        sort_root_moves(thread->root_moves, 0, thread->pv_index + 1);
+      }
+    }
+
+    if (thread->stopped) {
+      break;
+    }
+
+    // the first line is the result of the iteration
+    if (pv_lines > 1) {
+      restore_first_line(thread);
+    }
+
+    thread->best_move = thread->pv.pv_table[0][0];
+    thread->best_score = thread->score;
+    thread->completed_depth = thread->depth;
+
+    if (deterministic) {
+      // Soft node limit is also per thread, then wait for the others to finish
+      // this iteration so that the reported node count is reproducible
+      if (limits.nodes_set && thread->nodes >= limits.thread_node_limit) {
+        thread->stopped = 1;
+      }
+      barrier_wait(&iteration_barrier);
     }
 
     if (thread->index == 0) {
@@ -1036,14 +1169,19 @@ void *iterative_deepening(void *thread_void) {
         eval_stability = 0;
       }
 
-      if (limits.timeset && thread->depth > 7) {
-        scale_time(thread, best_move_stability, eval_stability);
+      if (limits.timeset && thread->depth > 7 && thread->best_move) {
+        double best_move_nodes =
+            (double)find_root_move(thread, thread->best_move)->nodes /
+            MAX(thread->nodes, 1);
+        scale_time(best_move_stability, eval_stability, best_move_nodes);
       }
     }
 
     if (thread->index == 0 &&
-        ((limits.timeset && get_time_ms() >= limits.soft_limit) ||
-         (limits.nodes_set && thread->nodes >= limits.node_limit))) {
+        ((limits.timeset && !limits.ponder &&
+          get_time_ms() >= limits.soft_limit) ||
+         (!deterministic && limits.nodes_set &&
+          thread->nodes >= limits.node_limit))) {
       stop_threads(thread, thread_count);
     }
 
@@ -1051,25 +1189,79 @@ void *iterative_deepening(void *thread_void) {
       // if PV is available
       if (thread->pv.pv_length[0]) {
         // print search info
-        print_thinking(thread, thread->score, thread->depth);
+        print_thinking(thread, thread->score, thread->depth, 0);
+      }
+      for (uint32_t line = 1; line < pv_lines; ++line) {
+        print_thinking(thread, thread->root_moves[line].score, thread->depth,
+                       line);
       }
     }
 
     if (thread->stopped) {
-      return NULL;
+      break;
     }
   }
+
+  if (deterministic) {
+    barrier_leave(&iteration_barrier);
+  }
   return NULL;
 }
 
+// reply to the best move stored in the hash table, used as the ponder move
+// when the search was stopped before the PV reached it
+static inline uint16_t tt_ponder_move(position_t *pos, uint16_t best_move) {
+  uint16_t ponder_move = 0, tt_move = 0;
+  int16_t tt_score;
+  uint8_t tt_depth, tt_flag, tt_pv;
+  undo_t undo;
+
+  make_move(pos, best_move, all_moves, &undo);
+  if (read_hash_entry(pos, 0, &tt_move, &tt_score, &tt_depth, &tt_flag,
+                      &tt_pv) &&
+      tt_move) {
+    // the entry may belong to another position with the same low key bits
+    moves move_list[1];
+    generate_moves(pos, move_list);
+    for (uint32_t i = 0; i < move_list->count; ++i) {
+      if (move_list->entry[i].move == tt_move) {
+        ponder_move = tt_move;
+      }
+    }
+  }
+  unmake_move(pos, best_move, &undo);
+
+  return ponder_move;
+}
+
+// Deterministic mode picks the result of the thread which completed the
+// deepest iteration, ties are broken by score and then by thread index
+static inline thread_t *select_best_thread(thread_t *threads) {
+  thread_t *best_thread = threads;
+  for (int i = 1; i < thread_count; ++i) {
+    if (threads[i].completed_depth > best_thread->completed_depth ||
+        (threads[i].completed_depth == best_thread->completed_depth &&
+         threads[i].best_score > best_thread->best_score)) {
+      best_thread = &threads[i];
+    }
+  }
+  return best_thread;
+}
+
 // search position for the best move
 void search_position(position_t *pos, thread_t *threads) {
   pthread_t pthreads[thread_count];
   for (int i = 0; i < thread_count; ++i) {
     threads[i].nodes = 0;
     threads[i].stopped = 0;
+    threads[i].best_move = 0;
+    threads[i].completed_depth = 0;
     memset(threads[i].killer_moves, 0, sizeof(threads[i].killer_moves));
     memcpy(&threads[i].pos, pos, sizeof(position_t));
+    init_root_moves(&threads[i], pos);
+    threads[i].key_history.count = game_history.count;
+    memcpy(threads[i].key_history.keys, game_history.keys,
+           game_history.count * sizeof(uint64_t));
     init_accumulator(pos, threads[i].accumulator);
   }
 
@@ -1077,6 +1269,18 @@ void search_position(position_t *pos, thread_t *threads) {
   memset(threads->pv.pv_table, 0, sizeof(threads->pv.pv_table));
   memset(threads->pv.pv_length, 0, sizeof(threads->pv.pv_length));
 
+  search_threads = threads;
+  if (deterministic) {
+    limits.thread_node_limit = MAX(limits.node_limit / thread_count, 1);
+    set_hash_partitions(thread_count);
+    barrier_init(&iteration_barrier, thread_count, synchronize_threads);
+  }
+
+  if (limits.timeset) {
+    atomic_store(&timer_running, true);
+    pthread_create(&timer, NULL, &timer_thread, threads);
+  }
+
   for (int thread_index = 1; thread_index < thread_count; ++thread_index) {
     pthread_create(&pthreads[thread_index], NULL, &iterative_deepening,
                    &threads[thread_index]);
@@ -1088,10 +1292,44 @@ void search_position(position_t *pos, thread_t *threads) {
     pthread_join(pthreads[i], NULL);
   }
 
+  if (limits.timeset) {
+    atomic_store(&timer_running, false);
+    pthread_join(timer, NULL);
+  }
+
+  // a finished ponder search may only answer after ponderhit or stop
+  while (limits.ponder) {
+    sleep_ms(1);
+  }
+
+  uint16_t best_move = threads->pv.pv_table[0][0];
+  uint16_t ponder_move =
+      threads->pv.pv_length[0] > 1 ? threads->pv.pv_table[0][1] : 0;
+
+  if (deterministic) {
+    barrier_destroy(&iteration_barrier);
+    set_hash_partitions(1);
+
+    thread_t *best_thread = select_best_thread(threads);
+    if (best_thread->best_move && best_thread->best_move != best_move) {
+      best_move = best_thread->best_move;
+      ponder_move = 0;
+    }
+    printf("info nodes %" PRIu64 "\n", total_nodes(threads, thread_count));
+  }
+
+  if (best_move && !ponder_move) {
+    ponder_move = tt_ponder_move(pos, best_move);
+  }
+
   // print best move
   printf("bestmove ");
-  if (threads->pv.pv_table[0][0]) {
-    print_move(threads->pv.pv_table[0][0]);
+  if (best_move) {
+    print_move(best_move);
+    if (ponder_move) {
+      printf(" ponder ");
+      print_move(ponder_move);
+    }
   } else {
     printf("(none)");
   }
@@ -31,25 +31,6 @@ static inline int move_estimated_value(position_t *pos, int move) {
   return value;
 }
 
-static inline uint64_t all_attackers_to_square(position_t *pos, uint64_t occupied, int sq) {
-
-  // When performing a static exchange evaluation we need to find all
-  // attacks to a given square, but we also are given an updated occupied
-  // bitboard, which will likely not match the actual board, as pieces are
-  // removed during the iterations in the static exchange evaluation
-
-  return (get_pawn_attacks(white, sq) & pos->bitboards[p]) |
-         (get_pawn_attacks(black, sq) & pos->bitboards[P]) |
-         (get_knight_attacks(sq) & (pos->bitboards[n] | pos->bitboards[N])) |
-         (get_bishop_attacks(sq, occupied) &
-          ((pos->bitboards[b] | pos->bitboards[B]) |
-           (pos->bitboards[q] | pos->bitboards[Q]))) |
-         (get_rook_attacks(sq, occupied) &
-          ((pos->bitboards[r] | pos->bitboards[R]) |
-           (pos->bitboards[q] | pos->bitboards[Q]))) |
-         (get_king_attacks(sq) & (pos->bitboards[k] | pos->bitboards[K]));
-}
-
 int SEE(position_t *pos, int move, int threshold) {
 
   int from, to, enpassant, promotion, colour, balance, nextVictim;
@@ -104,6 +85,11 @@ int SEE(position_t *pos, int move, int threshold) {
 
     // If we have no more attackers left we lose
     myAttackers = attackers & pos->occupancies[colour];
+
+    // Pinned pieces can not recapture while their pinner is still on the board
+    if (pos->check_info.pinners[!colour] & occupied)
+      myAttackers &= ~pos->check_info.pinned[colour];
+
     if (myAttackers == 0ull) {
       break;
     }
@@ -71,6 +71,8 @@ extern double DEF_INC_MULTIPLIER;
 extern double MAX_TIME_MULTIPLIER;
 extern double HARD_LIMIT_MULTIPLIER;
 extern double SOFT_LIMIT_MULTIPLIER;
+extern double NODE_TIME_BASE;
+extern double NODE_TIME_MULTIPLIER;
 
 extern int mvv[];
 extern int SEEPieceValues[];
@@ -199,6 +201,12 @@ void init_spsa_table(void) {
   add_double_spsa(STRINGIFY(SOFT_LIMIT_MULTIPLIER), &SOFT_LIMIT_MULTIPLIER, 0,
                   SPSA_MAX(SOFT_LIMIT_MULTIPLIER),
                   RATE_DOUBLE(SOFT_LIMIT_MULTIPLIER), NULL, 1);
+  add_double_spsa(STRINGIFY(NODE_TIME_BASE), &NODE_TIME_BASE, 1,
+                  SPSA_MAX(NODE_TIME_BASE), RATE_DOUBLE(NODE_TIME_BASE), NULL,
+                  1);
+  add_double_spsa(STRINGIFY(NODE_TIME_MULTIPLIER), &NODE_TIME_MULTIPLIER, 0,
+                  SPSA_MAX(NODE_TIME_MULTIPLIER),
+                  RATE_DOUBLE(NODE_TIME_MULTIPLIER), NULL, 1);
 }
 
 void print_spsa_table_uci(void) {
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #define MAX_PLY 254
+#define MAX_GAME_KEYS 256
 
 typedef struct spsa {
   void *value;
@@ -32,6 +33,21 @@ typedef struct tt_entry {
   uint8_t tt_pv : 1;
 } tt_entry_t;
 
+// perft hash entry, the key is stored xored with the data so an entry torn by
+// a concurrent write from another thread never matches
+typedef struct perft_entry {
+  uint64_t key;
+  uint64_t data; // node count << 8 | depth
+} perft_entry_t;
+
+// perft suite position with its reference node counts by depth, zero where
+// the count is not known
+typedef struct perft_suite {
+  char *fen;
+  uint64_t nodes[8];
+  uint8_t depth; // depth run when no depth is given
+} perft_suite_t;
+
 typedef struct move {
   int score;
   uint16_t move;
@@ -43,6 +59,11 @@ typedef struct moves {
   uint32_t count;
 } moves;
 
+// size of the cuckoo tables of reversible moves, see has_upcoming_repetition
+#define CUCKOO_SIZE 8192
+#define CUCKOO_H1(key) ((key) & (CUCKOO_SIZE - 1))
+#define CUCKOO_H2(key) (((key) >> 16) & (CUCKOO_SIZE - 1))
+
 typedef struct keys {
   uint64_t piece_keys[12][64];
   uint64_t enpassant_keys[64];
@@ -55,15 +76,23 @@ typedef struct accumulator {
                                              // lets have it this way
 } accumulator_t;
 
+// check and pin information of a position, updated after every move
+typedef struct check_info {
+  uint64_t checkers;   // enemy pieces giving check to the side to move
+  uint64_t pinned[2];  // pieces of each side pinned to their own king
+  uint64_t pinners[2]; // sliders of each side pinning an enemy piece
+} check_info_t;
+
 typedef struct position {
   uint64_t bitboards[12];
   uint64_t occupancies[3];
   uint64_t hash_key;
-  uint64_t repetition_table[1000];
-  uint32_t repetition_index;
+  check_info_t check_info;
   uint32_t ply;
   uint32_t seldepth;
   uint32_t fifty;
+  uint32_t reversible_plies; // fifty move counter including null moves
+  uint32_t plies_from_null;  // plies since the last null move
   int32_t excluded_move;
   uint8_t mailbox[64];
   uint8_t side;
@@ -71,6 +100,35 @@ typedef struct position {
   uint8_t castle;
 } position_t;
 
+// state that can not be recovered from the move when taking it back
+typedef struct undo {
+  uint64_t hash_key;
+  check_info_t check_info;
+  uint32_t fifty;
+  uint32_t reversible_plies;
+  uint32_t plies_from_null;
+  uint8_t captured_piece;
+  uint8_t enpassant;
+  uint8_t castle;
+} undo_t;
+
+// hash keys of the positions before the current one, the game part only
+// reaches back to the last irreversible move
+typedef struct key_stack {
+  uint64_t keys[MAX_GAME_KEYS + MAX_PLY];
+  uint32_t count;
+} key_stack_t;
+
+// root move with the effort spent on it over the iterations
+typedef struct root_move {
+  uint64_t nodes;     // nodes searched below the move
+  int score;          // score of the last search, -INF unless it raised alpha
+  int previous_score; // score at the end of the previous iteration
+  uint16_t move;
+  uint16_t pv[MAX_PLY]; // principal variation of its MultiPV line
+  uint8_t pv_length;
+} root_move_t;
+
 typedef struct PV {
   int32_t pv_length[MAX_PLY];
   int32_t pv_table[MAX_PLY][MAX_PLY];
@@ -82,11 +140,18 @@ typedef struct searchinfo {
   uint64_t nodes;
   uint64_t starttime;
   int score;
+  int best_score;
   int killer_moves[MAX_PLY];
   int16_t quiet_history[12][64][64];
-  int16_t capture_history[12][13][64][64];
+  int16_t capture_history[12][6][64][64]; // [piece][captured type][from][to]
   int16_t continuation_history[12][64][12][64];
   PV_t pv;
+  key_stack_t key_history;
+  root_move_t root_moves[280];
+  uint32_t root_move_count;
+  uint32_t pv_index; // MultiPV line being searched
+  uint16_t best_move;
+  uint8_t completed_depth;
   uint8_t depth;
   uint8_t stopped;
   uint8_t quit;
@@ -96,9 +161,10 @@ typedef struct searchinfo {
 typedef struct limits {
   uint64_t soft_limit;
   uint64_t hard_limit;
-  uint64_t start_time;
+  uint64_t start_time; // time management start, moved by ponderhit
   uint64_t time;
   uint64_t node_limit;
+  uint64_t thread_node_limit;
   uint32_t inc;
   uint32_t base_soft;
   uint32_t max_time;
@@ -106,6 +172,7 @@ typedef struct limits {
   uint8_t depth;
   uint8_t timeset;
   uint8_t nodes_set;
+  uint8_t ponder; // time limits apply only after ponderhit
 } limits_t;
 
 typedef struct searchthread {
@@ -115,14 +182,37 @@ typedef struct searchthread {
 } searchthreadinfo_t;
 
 typedef struct searchstack {
+  int16_t (*continuation_history)[64]; // [piece][target] follow ups of move
   uint16_t move;
   int excluded_move;
   int static_eval;
   int history_score;
-  uint8_t piece;
   uint8_t null_move;
 } searchstack_t;
 
+typedef struct movepicker {
+  moves noisy[1];
+  moves quiets[1];
+  thread_t *thread;
+  searchstack_t *ss;
+  uint16_t tt_move;
+  uint16_t killer;
+  uint8_t stage;
+  uint8_t captures_only;
+  uint8_t in_check;
+  uint8_t skip_quiets;
+} movepicker_t;
+
+// microseconds spent in each startup phase before the engine is ready
+typedef struct startup {
+  uint64_t start;
+  uint64_t threads;
+  uint64_t search;
+  uint64_t hash;
+  uint64_t nnue;
+  uint64_t total;
+} startup_t;
+
 typedef struct nnue_settings {
   char *nnue_file;
 } nnue_settings_t;
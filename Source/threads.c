@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "structs.h"
+#include "threads.h"
 
 thread_t *init_threads(int thread_count) {
     thread_t *threads;
@@ -44,3 +45,51 @@ void stop_threads(thread_t *threads, int thread_count) {
 		threads[i].stopped = 1;
 	}
 }
+
+void barrier_init(barrier_t *barrier, int count, void (*serial)(void)) {
+	pthread_mutex_init(&barrier->mutex, NULL);
+	pthread_cond_init(&barrier->cond, NULL);
+	barrier->generation = 0;
+	barrier->count = count;
+	barrier->waiting = 0;
+	barrier->serial = serial;
+}
+
+void barrier_destroy(barrier_t *barrier) {
+	pthread_mutex_destroy(&barrier->mutex);
+	pthread_cond_destroy(&barrier->cond);
+}
+
+// Releases all waiting threads, the serial callback is run by the last thread
+// to arrive while every other participant is still parked
+static inline void barrier_release(barrier_t *barrier) {
+	if (barrier->serial) {
+		barrier->serial();
+	}
+	barrier->waiting = 0;
+	barrier->generation++;
+	pthread_cond_broadcast(&barrier->cond);
+}
+
+void barrier_wait(barrier_t *barrier) {
+	pthread_mutex_lock(&barrier->mutex);
+	uint64_t generation = barrier->generation;
+	if (++barrier->waiting >= barrier->count) {
+		barrier_release(barrier);
+	} else {
+		while (generation == barrier->generation) {
+			pthread_cond_wait(&barrier->cond, &barrier->mutex);
+		}
+	}
+	pthread_mutex_unlock(&barrier->mutex);
+}
+
+// A thread that finished searching drops out so the rest are not blocked
+void barrier_leave(barrier_t *barrier) {
+	pthread_mutex_lock(&barrier->mutex);
+	barrier->count--;
+	if (barrier->waiting && barrier->waiting >= barrier->count) {
+		barrier_release(barrier);
+	}
+	pthread_mutex_unlock(&barrier->mutex);
+}
@@ -2,9 +2,23 @@
 #define THREADS_H
 
 #include "structs.h"
+#include <pthread.h>
+
+typedef struct barrier {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint64_t generation;
+  void (*serial)(void);
+  int count;
+  int waiting;
+} barrier_t;
 
 thread_t *init_threads(int thread_count);
 uint64_t total_nodes(thread_t *threads, int thread_count);
 void stop_threads(thread_t *threads, int thread_count);
+void barrier_init(barrier_t *barrier, int count, void (*serial)(void));
+void barrier_destroy(barrier_t *barrier);
+void barrier_wait(barrier_t *barrier);
+void barrier_leave(barrier_t *barrier);
 
 #endif
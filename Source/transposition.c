@@ -8,7 +8,7 @@
 #include <string.h>
 
 tt_t tt;
-extern keys_t keys;
+extern const keys_t keys;
 
 __extension__ typedef unsigned __int128 uint128_t;
 
@@ -23,19 +23,52 @@ int hash_full(void) {
   return used / (samples / 1000);
 }
 
-static inline uint64_t get_hash_index(uint64_t hash) {
-  return ((uint128_t)hash * (uint128_t)tt.num_of_entries) >> 64;
+// With partitions every thread only ever touches its own slice of the table
+// which keeps the deterministic multi-threaded search reproducible
+static inline uint64_t get_hash_index(uint64_t hash, uint8_t partition) {
+  if (tt.partitions <= 1) {
+    return ((uint128_t)hash * (uint128_t)tt.num_of_entries) >> 64;
+  }
+  return partition * tt.partition_size +
+         (((uint128_t)hash * (uint128_t)tt.partition_size) >> 64);
 }
 
 static inline uint32_t get_hash_low_bits(uint64_t hash) {
   return (uint32_t)hash;
 }
 
-void prefetch_hash_entry(uint64_t hash_key) {
-  const uint64_t index = get_hash_index(hash_key);
+void set_hash_partitions(uint16_t partitions) {
+  tt.partitions = partitions > 1 ? partitions : 1;
+  tt.partition_size = tt.num_of_entries / tt.partitions;
+}
+
+void prefetch_hash_entry(uint64_t hash_key, uint8_t partition) {
+  const uint64_t index = get_hash_index(hash_key, partition);
   __builtin_prefetch(&tt.hash_entry[index]);
 }
 
+// Copies the entry of a position from one partition into all the others
+// unless they already hold the same position searched at least as deep. A
+// position has the same offset inside every partition
+void share_hash_entry(uint64_t hash_key, uint8_t partition) {
+  if (tt.partitions <= 1) {
+    return;
+  }
+
+  const uint64_t offset = get_hash_index(hash_key, 0);
+  tt_entry_t *source = &tt.hash_entry[partition * tt.partition_size + offset];
+  if (source->hash_key != get_hash_low_bits(hash_key)) {
+    return;
+  }
+
+  for (uint16_t i = 0; i < tt.partitions; ++i) {
+    tt_entry_t *entry = &tt.hash_entry[i * tt.partition_size + offset];
+    if (entry->hash_key != source->hash_key || entry->depth < source->depth) {
+      *entry = *source;
+    }
+  }
+}
+
 uint64_t generate_hash_key(position_t *pos) {
   // final hash key
   uint64_t final_key = 0ULL;
@@ -88,6 +121,7 @@ void init_hash_table(uint64_t mb) {
 
   // init number of hash entries
   tt.num_of_entries = hash_size / sizeof(tt_entry_t);
+  set_hash_partitions(1);
 
   // free hash table if not empty
   if (tt.hash_entry != NULL) {
@@ -116,9 +150,11 @@ void init_hash_table(uint64_t mb) {
 }
 
 // read hash entry data
-uint8_t read_hash_entry(position_t *pos, uint16_t *move, int16_t *tt_score,
-                    uint8_t *tt_depth, uint8_t *tt_flag, uint8_t *tt_pv) {
-  tt_entry_t *hash_entry = &tt.hash_entry[get_hash_index(pos->hash_key)];
+uint8_t read_hash_entry(position_t *pos, uint8_t partition, uint16_t *move,
+                        int16_t *tt_score, uint8_t *tt_depth, uint8_t *tt_flag,
+                        uint8_t *tt_pv) {
+  tt_entry_t *hash_entry =
+      &tt.hash_entry[get_hash_index(pos->hash_key, partition)];
 
   // make sure we're dealing with the exact position we need
   if (hash_entry->hash_key == get_hash_low_bits(pos->hash_key)) {
@@ -141,11 +177,13 @@ uint8_t read_hash_entry(position_t *pos, uint16_t *move, int16_t *tt_score,
 }
 
 // write hash entry data
-void write_hash_entry(position_t *pos, int16_t score, uint8_t depth, uint16_t move,
-                      uint8_t hash_flag, uint8_t tt_pv) {
+void write_hash_entry(position_t *pos, uint8_t partition, int16_t score,
+                      uint8_t depth, uint16_t move, uint8_t hash_flag,
+                      uint8_t tt_pv) {
   // create a TT instance pointer to particular hash entry storing
   // the scoring data for the current board position if available
-  tt_entry_t *hash_entry = &tt.hash_entry[get_hash_index(pos->hash_key)];
+  tt_entry_t *hash_entry =
+      &tt.hash_entry[get_hash_index(pos->hash_key, partition)];
 
   uint8_t replace = hash_entry->hash_key != get_hash_low_bits(pos->hash_key) ||
                     depth + 4 > hash_entry->depth ||
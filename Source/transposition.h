@@ -7,6 +7,8 @@
 typedef struct tt {
   tt_entry_t *hash_entry;
   size_t num_of_entries;
+  size_t partition_size;
+  uint16_t partitions;
 } tt_t;
 
 extern tt_t tt;
@@ -18,11 +20,15 @@ extern tt_t tt;
 #define HASH_FLAG_UPPER_BOUND 3
 
 void clear_hash_table(void);
-void prefetch_hash_entry(uint64_t hash_key);
-uint8_t read_hash_entry(position_t *pos, uint16_t *move, int16_t *tt_score,
-                        uint8_t *tt_depth, uint8_t *tt_flag, uint8_t *tt_pv);
-void write_hash_entry(position_t *pos, int16_t score, uint8_t depth,
-                      uint16_t move, uint8_t hash_flag, uint8_t tt_pv);
+void set_hash_partitions(uint16_t partitions);
+void prefetch_hash_entry(uint64_t hash_key, uint8_t partition);
+void share_hash_entry(uint64_t hash_key, uint8_t partition);
+uint8_t read_hash_entry(position_t *pos, uint8_t partition, uint16_t *move,
+                        int16_t *tt_score, uint8_t *tt_depth, uint8_t *tt_flag,
+                        uint8_t *tt_pv);
+void write_hash_entry(position_t *pos, uint8_t partition, int16_t score,
+                      uint8_t depth, uint16_t move, uint8_t hash_flag,
+                      uint8_t tt_pv);
 void init_hash_table(uint64_t mb);
 uint64_t generate_hash_key(position_t *pos);
 int hash_full(void);
@@ -9,8 +9,10 @@
 \**********************************/
 
 #include "uci.h"
+#include "attacks.h"
 #include "bitboards.h"
 #include "enums.h"
+#include "history.h"
 #include "move.h"
 #include "movegen.h"
 #include "nnue.h"
@@ -23,22 +25,36 @@
 #include "transposition.h"
 #include "utils.h"
 #include <inttypes.h>
+#include <math.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 extern nnue_settings_t nnue_settings;
+extern startup_t startup;
+
+// positions of the game before the current one
+key_stack_t game_history;
 
 const int default_hash_size = 16;
 
 int thread_count = 1;
 
+// number of principal variations searched and reported
+int multi_pv = 1;
+
+// reproducible multi-threaded search, see search_position
+uint8_t deterministic = 0;
+
 double DEF_TIME_MULTIPLIER =  0.07261225544941069;
 double DEF_INC_MULTIPLIER = 0.8484297111945868;
 double MAX_TIME_MULTIPLIER = 0.7569425324273278;
 double HARD_LIMIT_MULTIPLIER = 3.0874339392141033;
 double SOFT_LIMIT_MULTIPLIER = 0.7698234902238437;
+double NODE_TIME_BASE = 1.5;
+double NODE_TIME_MULTIPLIER = 1.35;
 
 char *bench_positions[] = {
     "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
@@ -92,6 +108,46 @@ char *bench_positions[] = {
     "3br1k1/p1pn3p/1p3n2/5pNq/2P1p3/1PN3PP/P2Q1PB1/4R1K1 w - - 0 23",
     "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93"};
 
+// standard perft positions followed by en passant, castling, promotion and
+// mate edge cases
+perft_suite_t perft_suite_positions[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {0, 20, 400, 8902, 197281, 4865609, 119060324, 3195901860ULL}, 6},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {0, 48, 2039, 97862, 4085603, 193690690, 8031647685ULL}, 5},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {0, 14, 191, 2812, 43238, 674624, 11030083, 178633661}, 6},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {0, 6, 264, 9467, 422333, 15833292, 706045033}, 5},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {0, 44, 1486, 62379, 2103487, 89941194}, 5},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {0, 46, 2079, 89890, 3894594, 164075551, 6923051137ULL}, 5},
+    {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1",
+     {0, 18, 92, 1670, 10138, 185429, 1134888}, 6},
+    {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+     {0, 13, 102, 1266, 10276, 135655, 1015133}, 6},
+    {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+     {0, 15, 126, 1928, 13931, 206379, 1440467}, 6},
+    {"5k2/8/8/8/8/8/8/4K2R w K - 0 1",
+     {0, 15, 66, 1198, 6399, 120330, 661072}, 6},
+    {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1",
+     {0, 16, 71, 1286, 7418, 141077, 803711}, 6},
+    {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1",
+     {0, 26, 1141, 27826, 1274206}, 4},
+    {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",
+     {0, 44, 1494, 50509, 1720476}, 4},
+    {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",
+     {0, 11, 133, 1442, 19174, 266199, 3821001}, 6},
+    {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1",
+     {0, 29, 165, 5160, 31961, 1004658}, 5},
+    {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", {0, 9, 40, 472, 2661, 38983, 217342}, 6},
+    {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", {0, 6, 27, 273, 1329, 18135, 92683}, 6},
+    {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", {0, 2, 6, 13, 63, 382, 2217}, 6},
+    {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1",
+     {0, 10, 25, 268, 926, 10857, 43261, 567584}, 7},
+    {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", {0, 37, 183, 6559, 23527}, 4}};
+
 #define start_position                                                         \
   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 "
 
@@ -112,66 +168,50 @@ char promoted_pieces[] = {[Q] = 'q', [R] = 'r', [B] = 'b', [N] = 'n',
 //  parse user/GUI move string input (e.g. "e7e8q")
 static inline int parse_move(position_t *pos, thread_t *thread,
                              char *move_string) {
-  // create move list instance
-  moves move_list[1];
-
-  // generate moves
-  generate_moves(pos, move_list);
-
   // parse source square
   int source_square = (move_string[0] - 'a') + (8 - (move_string[1] - '0')) * 8;
   thread->starttime = 0;
   // parse target square
   int target_square = (move_string[2] - 'a') + (8 - (move_string[3] - '0')) * 8;
 
-  // loop over the moves within a move list
-  for (uint32_t move_count = 0; move_count < move_list->count; move_count++) {
-    // init move
-    int move = move_list->entry[move_count].move;
-
-    // make sure source & target squares are available within the generated move
-    if (source_square == get_move_source(move) &&
-        target_square == get_move_target(move)) {
-      // init promoted piece
-      int promoted_piece = get_move_promoted(pos->side, move);
-
-      // promoted piece is available
-      if (promoted_piece) {
-        // promoted to queen
-        if ((promoted_piece == Q || promoted_piece == q) &&
-            move_string[4] == 'q')
-          // return legal move
-          return move;
-
-        // promoted to rook
-        else if ((promoted_piece == R || promoted_piece == r) &&
-                 move_string[4] == 'r')
-          // return legal move
-          return move;
-
-        // promoted to bishop
-        else if ((promoted_piece == B || promoted_piece == b) &&
-                 move_string[4] == 'b')
-          // return legal move
-          return move;
-
-        // promoted to knight
-        else if ((promoted_piece == N || promoted_piece == n) &&
-                 move_string[4] == 'n')
-          // return legal move
-          return move;
-
-        // continue the loop on possible wrong promotions (e.g. "e7e8f")
-        continue;
-      }
-
-      // return legal move
-      return move;
-    }
+  if (source_square < 0 || source_square > 63 || target_square < 0 ||
+      target_square > 63)
+    return 0;
+
+  // rebuild the move flag from the board, the legality checks reject any
+  // flag the position does not allow
+  int piece_type = pos->mailbox[source_square] % 6;
+  int capture = pos->mailbox[target_square] != NO_PIECE;
+  int flag = capture ? CAPTURE : QUIET;
+
+  if (piece_type == KING && abs(target_square - source_square) == 2)
+    flag = target_square > source_square ? KING_CASTLE : QUEEN_CASTLE;
+  else if (piece_type == PAWN && pos->enpassant != no_sq &&
+           target_square == pos->enpassant)
+    flag = ENPASSANT_CAPTURE;
+  else if (piece_type == PAWN && abs(target_square - source_square) == 16)
+    flag = DOUBLE_PUSH;
+
+  // promoted piece is available
+  switch (move_string[4]) {
+  case 'n':
+    flag = capture ? KNIGHT_CAPTURE_PROMOTION : KNIGHT_PROMOTION;
+    break;
+  case 'b':
+    flag = capture ? BISHOP_CAPTURE_PROMOTION : BISHOP_PROMOTION;
+    break;
+  case 'r':
+    flag = capture ? ROOK_CAPTURE_PROMOTION : ROOK_PROMOTION;
+    break;
+  case 'q':
+    flag = capture ? QUEEN_CAPTURE_PROMOTION : QUEEN_PROMOTION;
+    break;
   }
 
-  // return illegal move
-  return 0;
+  uint16_t move = encode_move(source_square, target_square, flag);
+
+  // return legal move, 0 for an illegal one
+  return is_pseudo_legal(pos, move) && is_legal(pos, move) ? move : 0;
 }
 
 static inline void reset_board(position_t *pos) {
@@ -186,13 +226,10 @@ static inline void reset_board(position_t *pos) {
   pos->enpassant = no_sq;
   pos->castle = 0;
 
-  // reset repetition index
-  pos->repetition_index = 0;
-
   pos->fifty = 0;
 
-  // reset repetition table
-  memset(pos->repetition_table, 0ULL, sizeof(pos->repetition_table));
+  // reset game history
+  game_history.count = 0;
 }
 
 static inline void parse_fen(position_t *pos, char *fen) {
@@ -305,6 +342,8 @@ static inline void parse_fen(position_t *pos, char *fen) {
 
   // parse half move counter to init fifty move counter
   pos->fifty = atoi(fen);
+  pos->reversible_plies = pos->fifty;
+  pos->plies_from_null = pos->fifty;
 
   // loop over white pieces bitboards
   for (int piece = P; piece <= K; piece++)
@@ -322,6 +361,9 @@ static inline void parse_fen(position_t *pos, char *fen) {
 
   // init hash key
   pos->hash_key = generate_hash_key(pos);
+
+  // init checkers and pins
+  update_check_info(pos);
 }
 
 // parse UCI "position" command
@@ -380,14 +422,22 @@ static inline void parse_position(position_t *pos, thread_t *thread,
         // break out of the loop
         break;
 
-      // increment repetition index
-      pos->repetition_index++;
-
-      // write hash key into a repetition table
-      pos->repetition_table[pos->repetition_index] = pos->hash_key;
+      // remember the position for repetition detection, once full the
+      // oldest key goes as only the last hundred plies can repeat
+      if (game_history.count == MAX_GAME_KEYS) {
+        memmove(game_history.keys, game_history.keys + 1,
+                (MAX_GAME_KEYS - 1) * sizeof(uint64_t));
+        game_history.count--;
+      }
+      game_history.keys[game_history.count++] = pos->hash_key;
 
       // make move on the chess board
-      make_move(pos, move, all_moves);
+      undo_t undo;
+      make_move(pos, move, all_moves, &undo);
+
+      // positions before an irreversible move can never repeat
+      if (pos->fifty == 0)
+        game_history.count = 0;
 
       // move current character pointer to the end of current move
       while (*current_char && *current_char != ' ')
@@ -399,10 +449,13 @@ static inline void parse_position(position_t *pos, thread_t *thread,
   }
 }
 
-void scale_time(thread_t *thread, uint8_t best_move_stability, uint8_t eval_stability) {
+// the soft limit shrinks with the share of the nodes spent on the best move
+void scale_time(uint8_t best_move_stability, uint8_t eval_stability,
+                double best_move_nodes) {
   double bestmove_scale[5] = {2.43, 1.35, 1.09, 0.88, 0.68};
   double eval_scale[5] = {1.25, 1.15, 1.00, 0.94, 0.88};
-  limits.soft_limit = MIN(thread->starttime + limits.base_soft * bestmove_scale[best_move_stability] * eval_scale[eval_stability], limits.max_time + thread->starttime);
+  double node_scale = (NODE_TIME_BASE - best_move_nodes) * NODE_TIME_MULTIPLIER;
+  limits.soft_limit = MIN(limits.start_time + limits.base_soft * bestmove_scale[best_move_stability] * eval_scale[eval_stability] * node_scale, limits.max_time + limits.start_time);
 }
 
 static inline void time_control(position_t *pos, thread_t *threads,
@@ -414,6 +467,7 @@ static inline void time_control(position_t *pos, thread_t *threads,
   memset(&limits, 0, sizeof(limits_t));
 
   threads[0].starttime = get_time_ms();
+  limits.start_time = threads->starttime;
 
   // init argument
   char *argument = NULL;
@@ -422,6 +476,11 @@ static inline void time_control(position_t *pos, thread_t *threads,
   if ((argument = strstr(line, "infinite"))) {
   }
 
+  // search the expected reply, the limits below start counting at ponderhit
+  if ((argument = strstr(line, "ponder"))) {
+    limits.ponder = 1;
+  }
+
   if (pos->side == white) {
     if ((argument = strstr(line, "winc"))) {
       limits.inc = atoi(argument + 5);
@@ -477,8 +536,8 @@ static inline void time_control(position_t *pos, thread_t *threads,
       limits.max_time = MAX(1, limits.time * MAX_TIME_MULTIPLIER);
       limits.base_soft = MIN(base_time * SOFT_LIMIT_MULTIPLIER, limits.max_time);
       limits.hard_limit =
-          threads->starttime + MIN(base_time * HARD_LIMIT_MULTIPLIER, limits.max_time);
-      limits.soft_limit = threads->starttime + MIN(base_time * SOFT_LIMIT_MULTIPLIER, limits.max_time);
+          limits.start_time + MIN(base_time * HARD_LIMIT_MULTIPLIER, limits.max_time);
+      limits.soft_limit = limits.start_time + MIN(base_time * SOFT_LIMIT_MULTIPLIER, limits.max_time);
     }
   }
 }
@@ -513,6 +572,294 @@ void print_move(int move) {
            square_to_coordinates[get_move_target(move)]);
 }
 
+// run the bench positions to the given depth and return the node count
+static inline uint64_t bench_positions_run(position_t *pos, thread_t *threads,
+                                           char *go_command) {
+  char input[10000];
+  uint64_t nodes = 0;
+  for (int pos_index = 0; pos_index < 50; ++pos_index) {
+    memset(input, 0, sizeof(input));
+    strcpy(input, "position fen ");
+    strcat(input, bench_positions[pos_index]);
+    printf("\nPosition %d/%d (%s)\n", pos_index, 49,
+           bench_positions[pos_index]);
+
+    parse_position(pos, threads, input);
+    init_accumulator(pos, &threads->accumulator[pos->ply]);
+    time_control(pos, threads, go_command);
+    search_position(pos, threads);
+    nodes += total_nodes(threads, thread_count);
+  }
+  return nodes;
+}
+
+// single threaded bench used as the node count signature
+static inline void bench(position_t *pos, thread_t *threads) {
+  uint64_t total_nodes = 0;
+  uint64_t start_time = get_time_ms();
+  for (int pos_index = 0; pos_index < 50; ++pos_index) {
+    char input[10000];
+    memset(input, 0, sizeof(input));
+    strcpy(input, "position fen ");
+    strcat(input, bench_positions[pos_index]);
+    memset(threads, 0, sizeof(thread_t));
+    printf("\nPosition %d/%d (%s)\n", pos_index, 49,
+           bench_positions[pos_index]);
+
+    parse_position(pos, threads, input);
+    init_accumulator(pos, &threads->accumulator[pos->ply]);
+    time_control(pos, threads, "go depth 15");
+    search_position(pos, threads);
+    total_nodes += threads->nodes;
+  }
+  uint64_t total_time = get_time_ms() - start_time;
+  printf("\n%" PRIu64 " nodes %" PRIu64 " nps\n", total_nodes,
+         (total_nodes / (total_time + 1) * 1000));
+}
+
+// perft suite, checks move generation against the reference node counts
+// usage: perftsuite [depth]
+// Every position runs at the given depth, or at its deepest known count when
+// the depth is above it, and at its own default depth when no depth is given.
+// Depths are clamped to 1..7, a depth of 0 or below means no depth
+static inline void perft_suite(position_t *pos, thread_t *threads,
+                               const char *depth_string) {
+  int suite_size = sizeof(perft_suite_positions) / sizeof(perft_suite_t);
+  int passed = 0;
+  uint64_t total_nodes = 0, total_time = 0;
+  char input[10000];
+  int max_depth = 0;
+
+  if (depth_string) {
+    char *end;
+    long depth = strtol(depth_string, &end, 10);
+    while (*end == ' ' || *end == '\n' || *end == '\r')
+      end++;
+    if (*end) {
+      printf("info string perftsuite depth has to be a number\n");
+      return;
+    }
+    max_depth = depth > 0 ? MIN(depth, 7) : 0;
+  }
+
+  for (int pos_index = 0; pos_index < suite_size; ++pos_index) {
+    perft_suite_t *entry = &perft_suite_positions[pos_index];
+    int depth = max_depth ? max_depth : entry->depth;
+    while (!entry->nodes[depth])
+      depth--;
+
+    snprintf(input, sizeof(input), "position fen %s", entry->fen);
+    parse_position(pos, threads, input);
+
+    uint64_t start_time = get_time_ms();
+    uint64_t nodes = perft(pos, threads, depth);
+    uint64_t time = get_time_ms() - start_time;
+    int ok = nodes == entry->nodes[depth];
+
+    printf("Position %d/%d (%s): depth %d nodes %" PRIu64 " %s, %" PRIu64
+           " ms %" PRIu64 " nps\n",
+           pos_index + 1, suite_size, entry->fen, depth, nodes,
+           ok ? "ok" : "FAILED", time, nodes / (time + 1) * 1000);
+    if (!ok)
+      printf("    expected %" PRIu64 "\n", entry->nodes[depth]);
+
+    passed += ok;
+    total_nodes += nodes;
+    total_time += time;
+  }
+
+  printf("\nPerft suite: %d/%d passed, %" PRIu64 " nodes %" PRIu64
+         " ms %" PRIu64 " nps\n",
+         passed, suite_size, total_nodes, total_time,
+         total_nodes / (total_time + 1) * 1000);
+}
+
+// slider attack lookups, checks the PEXT and the magic lookups and the one the
+// engine was built with against the ray walk
+// usage: verifysliders
+static inline void verify_sliders(void) {
+  uint64_t lookups;
+  uint64_t failed = verify_sliders_attacks(&lookups);
+#ifdef USE_PEXT
+  const char *engine_lookup = "pext";
+#else
+  const char *engine_lookup = "magic";
+#endif
+  printf("Slider attacks: %" PRIu64 "/%" PRIu64
+         " lookups passed, engine uses %s lookups\n",
+         lookups - failed, lookups, engine_lookup);
+}
+
+#ifndef NDEBUG
+// MultiPV under time, checks that a search stopped while a later line was
+// searched still plays the move of the first line and that the finished lines
+// are ranked by score. Only built into debug builds
+// usage: Quanticade-debug multipvcheck
+static inline void multipv_check(position_t *pos, thread_t *threads) {
+  const int movetimes[] = {37, 89, 137, 389};
+  int saved_multi_pv = multi_pv;
+  int passed = 0, runs = 0, later_line_stops = 0;
+  char input[10000];
+
+  multi_pv = 4;
+  for (int pos_index = 0; pos_index < 8; ++pos_index) {
+    for (int time_index = 0; time_index < 4; ++time_index) {
+      snprintf(input, sizeof(input), "position fen %s",
+               bench_positions[pos_index]);
+      clear_hash_table();
+      clear_histories(threads, thread_count);
+      parse_position(pos, threads, input);
+      snprintf(input, sizeof(input), "go movetime %d", movetimes[time_index]);
+      time_control(pos, threads, input);
+      search_position(pos, threads);
+
+      // a stop in the first line plays its partial result like a single PV
+      // search, past it the first line is the result
+      uint16_t best_move = threads->pv.pv_table[0][0];
+      int ok = !threads->pv_index || best_move == threads->root_moves[0].move;
+      if (threads->pv_index && threads->pv_index < threads->root_move_count &&
+          threads->pv_index < (uint32_t)multi_pv)
+        later_line_stops++;
+
+      // the lines finished in the last iteration never gain score
+      int ranked = 1;
+      for (uint32_t line = 1; line < threads->pv_index; ++line) {
+        if (threads->root_moves[line].score >
+            threads->root_moves[line - 1].score)
+          ranked = 0;
+      }
+
+      printf("Position %d/8 (%s) movetime %d: %s\n", pos_index + 1,
+             bench_positions[pos_index], movetimes[time_index],
+             !ok       ? "FAILED, played a move of a later line"
+             : !ranked ? "FAILED, lines out of score order"
+                       : "ok");
+      passed += ok && ranked;
+      runs++;
+    }
+  }
+  multi_pv = saved_multi_pv;
+
+  printf("\nMultiPV check: %d/%d passed, %d stopped in a later line\n", passed,
+         runs, later_line_stops);
+}
+#endif
+
+// The opponent played the expected move, the ponder search continues as a
+// normal search. Only the time management starts counting now, the info
+// output keeps measuring from the start of the search
+static inline void ponder_hit(void) {
+  uint64_t elapsed = get_time_ms() - limits.start_time;
+  limits.start_time += elapsed;
+  limits.soft_limit += elapsed;
+  limits.hard_limit += elapsed;
+  // the deadlines are only read once pondering is off
+  atomic_thread_fence(memory_order_release);
+  limits.ponder = 0;
+}
+
+// time spent in each startup phase until the first readyok can be sent
+static inline void print_startup(void) {
+  printf("info string startup threads %" PRIu64 " us search %" PRIu64
+         " us hash %" PRIu64 " us nnue %" PRIu64 " us total %" PRIu64
+         " us\n",
+         startup.threads, startup.search, startup.hash, startup.nnue,
+         startup.total);
+}
+
+// SMP scaling bench
+// usage: bench smp [max threads] [depth] [runs] [hash MB...]
+// Runs the bench positions at 1, 2, 4 ... max threads for every hash size and
+// reports time to depth, nps, speedup, efficiency and node count deviation
+static inline void bench_smp(position_t *pos, thread_t *threads, int argc,
+                             char *argv[]) {
+  int max_threads = argc >= 1 ? MAX(1, atoi(argv[0])) : 8;
+  int depth = argc >= 2 ? clamp(atoi(argv[1]), 1, MAX_PLY) : 13;
+  int runs = argc >= 3 ? clamp(atoi(argv[2]), 1, 100) : 3;
+  int default_hashes[] = {16, 64};
+  int hash_count = argc >= 4 ? MIN(argc - 3, 8) : 2;
+  int hashes[8];
+  for (int i = 0; i < hash_count; ++i) {
+    hashes[i] = argc >= 4 ? MAX(4, atoi(argv[3 + i])) : default_hashes[i];
+  }
+
+  int thread_counts[16];
+  int thread_configs = 0;
+  for (int count = 1; thread_configs < 16; count *= 2) {
+    thread_counts[thread_configs++] = MIN(count, max_threads);
+    if (count >= max_threads) {
+      break;
+    }
+  }
+
+  char go_command[32];
+  snprintf(go_command, sizeof(go_command), "go depth %d", depth);
+
+  double times[8][16], nodes[8][16], deviation[8][16];
+
+  for (int hash_index = 0; hash_index < hash_count; ++hash_index) {
+    init_hash_table(hashes[hash_index]);
+    for (int config = 0; config < thread_configs; ++config) {
+      #ifndef _WIN32
+      free(threads);
+      #else
+      _aligned_free(threads);
+      #endif
+      thread_count = thread_counts[config];
+      threads = init_threads(thread_count);
+
+      double time_sum = 0, node_sum = 0, node_square_sum = 0;
+      for (int run = 0; run < runs; ++run) {
+        // every run starts from the same empty state
+        clear_hash_table();
+        memset(threads, 0, sizeof(thread_t) * thread_count);
+        for (int i = 0; i < thread_count; ++i) {
+          threads[i].index = i;
+        }
+
+        uint64_t start_time = get_time_ms();
+        uint64_t run_nodes = bench_positions_run(pos, threads, go_command);
+        uint64_t run_time = MAX(get_time_ms() - start_time, 1);
+
+        time_sum += run_time;
+        node_sum += run_nodes;
+        node_square_sum += (double)run_nodes * run_nodes;
+      }
+
+      times[hash_index][config] = time_sum / runs;
+      nodes[hash_index][config] = node_sum / runs;
+      deviation[hash_index][config] =
+          sqrt(fmax(node_square_sum / runs -
+                        nodes[hash_index][config] * nodes[hash_index][config],
+                    0));
+    }
+  }
+
+  printf("\nSMP bench: depth %d, %d run(s) per configuration\n\n", depth,
+         runs);
+  printf("%8s %8s %12s %14s %12s %8s %10s %14s\n", "Hash", "Threads",
+         "TTD ms", "Nodes", "NPS", "Speedup", "Efficiency", "Node stddev");
+  for (int hash_index = 0; hash_index < hash_count; ++hash_index) {
+    for (int config = 0; config < thread_configs; ++config) {
+      double speedup = times[hash_index][0] / times[hash_index][config];
+      printf("%8d %8d %12.0f %14.0f %12.0f %8.2f %9.1f%% %13.0f (%.2f%%)\n",
+             hashes[hash_index], thread_counts[config], times[hash_index][config],
+             nodes[hash_index][config],
+             nodes[hash_index][config] / times[hash_index][config] * 1000,
+             speedup, 100 * speedup / thread_counts[config],
+             deviation[hash_index][config],
+             100 * deviation[hash_index][config] /
+                 fmax(nodes[hash_index][config], 1));
+    }
+  }
+
+  #ifndef _WIN32
+  free(threads);
+  #else
+  _aligned_free(threads);
+  #endif
+}
+
 // main UCI loop
 void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]) {
   // max hash MB
@@ -539,27 +886,34 @@ void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]) {
   parse_position(pos, threads, "position startpos");
   init_accumulator(pos, &threads->accumulator[pos->ply]);
 
+  // the engine answers isready from here on
+  startup.total = get_time_us() - startup.start;
+
   if (argc >= 2) {
+    if (strncmp("startup", argv[1], 7) == 0) {
+      print_startup();
+      return;
+    }
+    if (strncmp("perftsuite", argv[1], 10) == 0) {
+      perft_suite(pos, threads, argc >= 3 ? argv[2] : NULL);
+      return;
+    }
+#ifndef NDEBUG
+    if (strncmp("multipvcheck", argv[1], 12) == 0) {
+      multipv_check(pos, threads);
+      return;
+    }
+#endif
+    if (strncmp("verifysliders", argv[1], 13) == 0) {
+      verify_sliders();
+      return;
+    }
     if (strncmp("bench", argv[1], 5) == 0) {
-      uint64_t total_nodes = 0;
-      uint64_t start_time = get_time_ms();
-      for (int pos_index = 0; pos_index < 50; ++pos_index) {
-        memset(input, 0, sizeof(input));
-        strcpy(input, "position fen ");
-        strcat(input, bench_positions[pos_index]);
-        memset(threads, 0, sizeof(thread_t));
-        printf("\nPosition %d/%d (%s)\n", pos_index, 49,
-               bench_positions[pos_index]);
-
-        parse_position(pos, threads, input);
-        init_accumulator(pos, &threads->accumulator[pos->ply]);
-        time_control(pos, threads, "go depth 15");
-        search_position(pos, threads);
-        total_nodes += threads->nodes;
+      if (argc >= 3 && strncmp("smp", argv[2], 3) == 0) {
+        bench_smp(pos, threads, argc - 3, argv + 3);
+      } else {
+        bench(pos, threads);
       }
-      uint64_t total_time = get_time_ms() - start_time;
-      printf("\n%" PRIu64 " nodes %" PRIu64 " nps\n", total_nodes,
-             (total_nodes / (total_time + 1) * 1000));
       return;
     }
   }
@@ -598,12 +952,7 @@ void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]) {
     else if (strncmp(input, "ucinewgame", 10) == 0) {
       // clear hash table
       clear_hash_table();
-      for (int i = 0; i < thread_count; ++i) {
-        memset(threads[i].quiet_history, 0, sizeof(threads[i].quiet_history));
-        memset(threads[i].capture_history, 0,
-               sizeof(threads[i].capture_history));
-        memset(threads[i].continuation_history, 0, sizeof(threads[i].continuation_history));
-      }
+      clear_histories(threads, thread_count);
     }
     // parse UCI "go" command
     else if (strncmp(input, "go", 2) == 0) {
@@ -613,7 +962,12 @@ void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]) {
       pthread_create(&search_thread, NULL, &parse_go, &sti);
     }
 
+    else if (strncmp(input, "ponderhit", 9) == 0) {
+      ponder_hit();
+    }
+
     else if (strncmp(input, "stop", 4) == 0) {
+      limits.ponder = 0;
       stop_threads(threads, thread_count);
       pthread_join(search_thread, NULL);
     }
@@ -634,12 +988,21 @@ void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]) {
       printf("option name EvalFile type string default %s\n",
              nnue_settings.nnue_file);
       printf("option name Clear Hash type button\n");
+      printf("option name Ponder type check default false\n");
+      printf("option name MultiPV type spin default 1 min 1 max 256\n");
+      printf("option name Deterministic type check default false\n");
       // SPSA
       print_spsa_table_uci();
       // uciok
       printf("uciok\n");
     } else if (strncmp(input, "spsa", 4) == 0) {
       print_spsa_table();
+    } else if (strncmp(input, "startup", 7) == 0) {
+      print_startup();
+    } else if (strncmp(input, "perftsuite", 10) == 0) {
+      perft_suite(pos, threads, input + 10);
+    } else if (strncmp(input, "verifysliders", 13) == 0) {
+      verify_sliders();
     }
 
     else if (!strncmp(input, "setoption name Hash value ", 26)) {
@@ -677,6 +1040,14 @@ void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]) {
       nnue_init(nnue_settings.nnue_file);
     }
 
+    else if (!strncmp(input, "setoption name MultiPV value ", 29)) {
+      multi_pv = clamp(atoi(input + 29), 1, 256);
+    }
+
+    else if (!strncmp(input, "setoption name Deterministic value ", 35)) {
+      deterministic = !strncmp(input + 35, "true", 4);
+    }
+
     else if (!strncmp(input, "setoption name Clear Hash", 25)) {
       clear_hash_table();
     } else if (!strncmp(input, "setoption name SyzygyPath value ", 32)) {
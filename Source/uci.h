@@ -15,6 +15,7 @@ extern char promoted_pieces[];
 
 void uci_loop(position_t *pos, thread_t *threads, int argc, char *argv[]);
 void print_move(int move);
-void scale_time(thread_t *thread, uint8_t best_move_stability, uint8_t eval_stability);
+void scale_time(uint8_t best_move_stability, uint8_t eval_stability,
+                double best_move_nodes);
 
 #endif
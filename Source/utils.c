@@ -9,6 +9,7 @@
 #include <windows.h>
 #else
 #include <sys/time.h>
+#include <time.h>
 #endif
 
 // Misc functions. Some of them from VICE by Richard Allbert
@@ -18,13 +19,33 @@ int clamp(int d, int min, int max) {
   return t > max ? max : t;
 }
 
+// monotonic clock, wall clock adjustments must not move the search deadlines
 uint64_t get_time_ms(void) {
 #ifdef WIN64
   return GetTickCount();
 #else
-  struct timeval time_value;
-  gettimeofday(&time_value, NULL);
-  return time_value.tv_sec * 1000 + time_value.tv_usec / 1000;
+  struct timespec time_value;
+  clock_gettime(CLOCK_MONOTONIC, &time_value);
+  return time_value.tv_sec * 1000ULL + time_value.tv_nsec / 1000000;
+#endif
+}
+
+uint64_t get_time_us(void) {
+#ifdef WIN64
+  return GetTickCount() * 1000ULL;
+#else
+  struct timespec time_value;
+  clock_gettime(CLOCK_MONOTONIC, &time_value);
+  return time_value.tv_sec * 1000000ULL + time_value.tv_nsec / 1000;
+#endif
+}
+
+void sleep_ms(uint32_t ms) {
+#ifdef WIN64
+  Sleep(ms);
+#else
+  struct timespec duration = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&duration, NULL);
 #endif
 }
 
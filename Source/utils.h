@@ -3,8 +3,13 @@
 
 #include "structs.h"
 
+// force inlining of functions specialized through constant arguments
+#define FORCE_INLINE inline __attribute__((always_inline))
+
 int clamp(int d, int min, int max);
 uint64_t get_time_ms(void);
+uint64_t get_time_us(void);
+void sleep_ms(uint32_t ms);
 int input_waiting(void);
 void read_input(thread_t *thread);
 
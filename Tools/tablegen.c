@@ -0,0 +1,197 @@
+// Generates the attack and Zobrist tables at build time. It is linked with
+// Source/attacks.c compiled with TABLEGEN, runs the table init code once and
+// prints every table as a constant C definition for the engine build
+#include "attacks.h"
+#include "enums.h"
+#include "move.h"
+#include "structs.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+keys_t keys;
+uint64_t random_state;
+uint64_t cuckoo_keys[CUCKOO_SIZE];
+uint32_t cuckoo_moves[CUCKOO_SIZE];
+
+// generate 64-bit pseudo random numbers with xorshift64*. The output has to
+// use the whole 64-bit state, keys built from a 32-bit generator are linearly
+// dependent and collide like 32-bit keys
+static uint64_t get_random_uint64_number(void) {
+  // XOR shift algorithm
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+
+  // scramble the state into the returned number
+  return random_state * 2685821657736338717ULL;
+}
+
+// init random hash keys (zobrist keys)
+static void init_random_keys(void) {
+  // update pseudo random number state
+  random_state = 1804289383;
+
+  // loop over piece codes
+  for (int piece = P; piece <= k; piece++) {
+    // loop over board squares
+    for (int square = 0; square < 64; square++)
+      // init random piece keys
+      keys.piece_keys[piece][square] = get_random_uint64_number();
+  }
+
+  // loop over board squares
+  for (int square = 0; square < 64; square++)
+    // init random enpassant keys
+    keys.enpassant_keys[square] = get_random_uint64_number();
+
+  // loop over castling keys
+  for (int index = 0; index < 16; index++)
+    // init castling keys
+    keys.castle_keys[index] = get_random_uint64_number();
+
+  // init random side key
+  keys.side_key = get_random_uint64_number();
+}
+
+// Stores the key change of every reversible piece move on an empty board in a
+// cuckoo hash, so search can tell if a single move links two positions
+static void init_cuckoo_tables(void) {
+  int count = 0;
+
+  // loop over pieces other than pawns of both sides
+  for (int piece = P; piece <= k; piece++) {
+    if (piece == P || piece == p)
+      continue;
+
+    int piece_type = piece % 6;
+    for (int source = 0; source < 64; source++) {
+      uint64_t attacks;
+      if (piece_type == KNIGHT)
+        attacks = knight_attacks[source];
+      else if (piece_type == BISHOP)
+        attacks = bishop_attacks_on_the_fly(source, 0ULL);
+      else if (piece_type == ROOK)
+        attacks = rook_attacks_on_the_fly(source, 0ULL);
+      else if (piece_type == QUEEN)
+        attacks = bishop_attacks_on_the_fly(source, 0ULL) |
+                  rook_attacks_on_the_fly(source, 0ULL);
+      else
+        attacks = king_attacks[source];
+
+      // both directions share a key, store each square pair once
+      for (int target = source + 1; target < 64; target++) {
+        if (!get_bit(attacks, target))
+          continue;
+
+        uint32_t move = encode_move(source, target, QUIET);
+        uint64_t key = keys.piece_keys[piece][source] ^
+                       keys.piece_keys[piece][target] ^ keys.side_key;
+
+        // insert, kicking out the current entry to its other slot until an
+        // empty slot is found
+        uint32_t slot = CUCKOO_H1(key);
+        while (1) {
+          uint64_t kicked_key = cuckoo_keys[slot];
+          uint32_t kicked_move = cuckoo_moves[slot];
+          cuckoo_keys[slot] = key;
+          cuckoo_moves[slot] = move;
+          if (!kicked_move)
+            break;
+
+          key = kicked_key;
+          move = kicked_move;
+          slot = slot == CUCKOO_H1(key) ? CUCKOO_H2(key) : CUCKOO_H1(key);
+        }
+        count++;
+      }
+    }
+  }
+
+  assert(count == 3668);
+}
+
+// print a braced list of 64-bit values
+static void print_values(const uint64_t *values, int count, int indent) {
+  printf("{");
+  for (int index = 0; index < count; index++) {
+    if (index % 4 == 0)
+      printf("\n%*s", indent + 2, "");
+    printf("0x%016" PRIx64 "ULL%s", values[index],
+           index + 1 < count ? ", " : "");
+  }
+  printf("}");
+}
+
+// print a braced list of rows of 64-bit values
+static void print_rows(const uint64_t *values, int rows, int columns) {
+  printf("{");
+  for (int row = 0; row < rows; row++) {
+    printf("\n  ");
+    print_values(values + row * columns, columns, 2);
+    printf("%s", row + 1 < rows ? "," : "");
+  }
+  printf("}");
+}
+
+// print a table of 64-bit values
+static void print_table(const char *declaration, const uint64_t *values,
+                        int rows, int columns) {
+  printf("\n%s = ", declaration);
+  if (rows == 1)
+    print_values(values, columns, 0);
+  else
+    print_rows(values, rows, columns);
+  printf(";\n");
+}
+
+// print a table of small values like square offsets or moves
+static void print_offsets(const char *declaration, const uint32_t *offsets,
+                          int count) {
+  printf("\n%s = {", declaration);
+  for (int index = 0; index < count; index++)
+    printf("%s%" PRIu32 "%s", index % 8 == 0 ? "\n  " : "", offsets[index],
+           index + 1 < count ? ", " : "");
+  printf("};\n");
+}
+
+int main(void) {
+  init_leapers_attacks();
+  init_sliders_attacks();
+  init_random_keys();
+  init_cuckoo_tables();
+
+  printf("// Generated by Tools/tablegen.c, do not edit\n");
+  printf("#include \"attacks.h\"\n");
+  printf("#include \"structs.h\"\n");
+
+  print_table("const uint64_t pawn_attacks[2][64]", pawn_attacks[0], 2, 64);
+  print_table("const uint64_t knight_attacks[64]", knight_attacks, 1, 64);
+  print_table("const uint64_t king_attacks[64]", king_attacks, 1, 64);
+  print_table("const uint64_t slider_attacks[SLIDER_TABLE_SIZE]",
+              slider_attacks, 1, SLIDER_TABLE_SIZE);
+  print_offsets("const uint32_t bishop_offsets[64]", bishop_offsets, 64);
+  print_offsets("const uint32_t rook_offsets[64]", rook_offsets, 64);
+  print_table("const uint64_t bishop_masks[64]", bishop_masks, 1, 64);
+  print_table("const uint64_t rook_masks[64]", rook_masks, 1, 64);
+  print_table("const uint64_t between_masks[64][64]", between_masks[0], 64,
+              64);
+  print_table("const uint64_t line_masks[64][64]", line_masks[0], 64, 64);
+
+  // zobrist keys
+  printf("\nconst keys_t keys = {\n  ");
+  print_rows(keys.piece_keys[0], 12, 64);
+  printf(",\n  ");
+  print_values(keys.enpassant_keys, 64, 2);
+  printf(",\n  ");
+  print_values(keys.castle_keys, 16, 2);
+  printf(",\n  0x%016" PRIx64 "ULL};\n", keys.side_key);
+
+  // reversible move keys
+  print_table("const uint64_t cuckoo_keys[CUCKOO_SIZE]", cuckoo_keys, 1,
+              CUCKOO_SIZE);
+  print_offsets("const uint16_t cuckoo_moves[CUCKOO_SIZE]", cuckoo_moves,
+                CUCKOO_SIZE);
+
+  return 0;
+}